@@ -5,12 +5,20 @@
 #
 #   docker run --rm -v /amiga:/amiga -it amigadev/crosstools:m68k-amigaos bash
 #
+# Add -DAOS_COUNTERS to count graphics calls, pixels and bytes per frame (common/counters.h).
+#
 
 gcc hello/null.c -lamiga -lm -o build/null
 gcc hello/hello.c -lamiga -lm -o build/hello
 gcc hello/graphics.c -lamiga -lm -o build/graphics
 gcc window/window.c -lamiga -lm -o build/window
+gcc window/render.c -lamiga -lm -o build/window-render
 gcc screen/doublebuffer.c -lamiga -lm -o build/doublebuffer
 gcc screen/fullscreen.c -lamiga -lm -o build/fullscreen
+gcc screen/sprites.c -lamiga -lm -o build/sprites
+gcc screen/flock.c -lamiga -lm -o build/flock
+gcc screen/polygons.c -lamiga -lm -o build/polygons
+gcc screen/showiff.c -lamiga -lm -o build/showiff
 gcc cybergraphx/listmodes.c -lamiga -lm -o build/cgx-listmodes
-gcc cybergraphx/fullscreen.c -lamiga -lm -o build/cgx-fullscreen
\ No newline at end of file
+gcc cybergraphx/fullscreen.c -lamiga -lm -o build/cgx-fullscreen
+gcc cybergraphx/starfield.c -lamiga -lm -o build/cgx-starfield
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef AOS_COMMON_ARENA_H
+#define AOS_COMMON_ARENA_H
+
+/*
+ * Double-buffered linear allocator for per-frame scratch data (draw lists, dirty rects, span buffers...).
+ *
+ * The backing block is split into two halves.  Allocations bump a pointer in the current half and are never
+ * freed individually.  FrameArena_nextFrame() flips to the other half and resets it, so whatever was allocated
+ * during the previous frame stays valid for one more frame.
+ *
+ * The arena doesn't allocate memory itself - hand it a block sized once at startup.  No per-frame calls into
+ * exec, so nothing fragments Chip / Fast RAM.  Check the high water mark at exit to size the block.
+ */
+
+#define FRAME_ARENA_ALIGN 4
+
+typedef struct sFrameArena {
+    unsigned char* base[2];
+    unsigned long size;       /* bytes in each half */
+    unsigned long used;       /* bytes used in the current half */
+    unsigned long highWater;  /* most bytes used by any one frame */
+    unsigned long failed;     /* allocations that didn't fit, non zero means the arena is too small */
+    int current;
+} FrameArena;
+
+/* Allocate 'count' items of 'type' from the current frame */
+#define FrameArena_new(arena, type, count) ((type*) FrameArena_alloc((arena), sizeof(type) * (count)))
+
+/* 'mem' must be at least 'size' bytes, each frame gets half of it */
+static void FrameArena_init(FrameArena* arena, void* mem, unsigned long size) {
+    unsigned long half = (size / 2) & ~(unsigned long) (FRAME_ARENA_ALIGN - 1);
+
+    arena->base[0] = (unsigned char*) mem;
+    arena->base[1] = (unsigned char*) mem + half;
+    arena->size = half;
+    arena->used = 0;
+    arena->highWater = 0;
+    arena->failed = 0;
+    arena->current = 0;
+}
+
+/* Returns NULL when the current frame is full, memory is not cleared */
+static inline void* FrameArena_alloc(FrameArena* arena, unsigned long size) {
+    unsigned long start = arena->used;
+    size = (size + FRAME_ARENA_ALIGN - 1) & ~(unsigned long) (FRAME_ARENA_ALIGN - 1);
+
+    if (size > arena->size - start) {
+        arena->failed++;
+        return 0;
+    }
+
+    arena->used = start + size;
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+
+    return arena->base[arena->current] + start;
+}
+
+/* Call once at the start of each frame.  Invalidates everything allocated two frames ago. */
+static inline void FrameArena_nextFrame(FrameArena* arena) {
+    arena->current ^= 1;
+    arena->used = 0;
+}
+
+#endif
@@ -0,0 +1,602 @@
+#ifndef AOS_COMMON_CAPTURE_H
+#define AOS_COMMON_CAPTURE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+#include "memory.h"
+#include "startup.h"
+
+#ifdef AOS_HOST
+#include <pthread.h>
+#else
+#include <exec/ports.h>
+#include <devices/timer.h>
+#include <dos/dos.h>
+#include <dos/dostags.h>
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+#endif
+
+/*
+ * Delta compressed capture of what was drawn, for regression checks and bug reports.
+ *
+ * Capture_frame() compares each row of the frame with the last frame it recorded and only encodes rows that
+ * changed: the row is XORed with the old one (unchanged bytes become zero runs) and packed with ByteRun1.
+ * Encoded frames go into one of two buffers.  A full buffer is handed to a writer process (a thread on the
+ * host) which does the actual disk writes, while the main loop carries on filling the other buffer.  If the
+ * writer still has the other buffer when the current one fills up, the frame is dropped and counted rather
+ * than waiting: the next frame is diffed against the last one recorded, so the file stays consistent and
+ * the decoder sees the gap in the frame numbers.
+ *
+ * Frames are either one 8 bit chunky plane (CAPTURE_CHUNKY) or 'depth' bitplanes (CAPTURE_PLANAR).
+ * tools/capture2ppm.c turns a file back into images.
+ *
+ * Frame times are wall clock from Startup_now() (common/startup.h), as in common/replay.h: timer.device is
+ * opened by Capture_open() if the program hasn't, and the program defines TimerBase.
+ *
+ * File format, all multi byte values big endian, counts as unsigned LEB128 varints (as common/replay.h):
+ *
+ *   "AOSC" version(1) width(2) height(2) format(1) depth(1)
+ *   records:
+ *     CAPTURE_REC_PALETTE  first(var) count(var) count * rgb(3)
+ *     CAPTURE_REC_FRAME    frameDelta(var) msDelta(var) numRows(2) numRows * (rowDelta(var) ByteRun1(row XOR
+ *                          previous))       - rows are numbered plane * height + y, rowDelta is the gap
+ *                                             since the last changed row + 1
+ *     CAPTURE_REC_END
+ */
+
+#define CAPTURE_CHUNKY 0
+#define CAPTURE_PLANAR 1
+
+#define CAPTURE_VERSION 1
+
+#define CAPTURE_REC_PALETTE 1
+#define CAPTURE_REC_FRAME 2
+#define CAPTURE_REC_END 0xff
+
+#define CAPTURE_MAX_PLANES 8
+#define CAPTURE_FLUSH_SIZE 16384
+
+typedef struct sCaptureBuffer {
+#ifndef AOS_HOST
+    struct Message msg;             /* must be first, sent to the writer process */
+#endif
+    unsigned char* data;            /* NULL for the writer's quit message */
+    unsigned long used;
+    volatile int busy;              /* owned by the writer */
+} CaptureBuffer;
+
+typedef struct sCapture {
+    int width;
+    int height;
+    int format;
+    int depth;
+    int rowBytes;
+    int numRows;                    /* rows of all planes */
+    unsigned char* previous;        /* last recorded frame */
+    unsigned char* scratch;         /* one XORed row */
+    unsigned long palette[256];
+    int paletteValid;
+
+    CaptureBuffer buffers[2];
+    int current;
+    unsigned long bufferSize;
+    unsigned long worstFrame;
+
+    unsigned long frame;            /* frames offered */
+    unsigned long lastFrame;        /* frame number of the last one recorded */
+    unsigned long lastMs;
+    unsigned long long start;       /* Startup_now() ticks */
+    unsigned long ticksPerSecond;
+
+    /* stats */
+    unsigned long framesRecorded;
+    unsigned long dropped;
+    unsigned long rowsChanged;
+    unsigned long bytesIn;
+    unsigned long bytesOut;
+    unsigned long writeErrors;
+
+#ifdef AOS_HOST
+    FILE* file;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int queue[2];
+    int queued;
+    int quit;
+#else
+    BPTR file;
+    struct Task* mainTask;
+    struct MsgPort* replyPort;
+    struct MsgPort* writerPort;
+    CaptureBuffer quitMsg;
+    struct IORequest timer;         /* only when TimerBase wasn't set up already */
+#endif
+} Capture;
+
+static unsigned char* Capture_putVar(unsigned char* out, unsigned long v) {
+    while (v >= 0x80) {
+        *out++ = (unsigned char) ((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    *out++ = (unsigned char) v;
+    return out;
+}
+
+/* ByteRun1 (IFF) packing: n 0..127 copies n + 1 bytes, n -1..-127 repeats the next byte -n + 1 times */
+static unsigned char* Capture_byteRun1(unsigned char* out, const unsigned char* src, int length) {
+    int i = 0;
+
+    while (i < length) {
+        int run = 1;
+        while (i + run < length && run < 128 && src[i + run] == src[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            *out++ = (unsigned char) (1 - run);
+            *out++ = src[i];
+            i += run;
+            continue;
+        }
+
+        /* literals up to the next run of 3 */
+        int start = i;
+        while (i < length && i - start < 128) {
+            if (i + 2 < length && src[i] == src[i + 1] && src[i] == src[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        *out++ = (unsigned char) (i - start - 1);
+        memcpy(out, src + start, i - start);
+        out += i - start;
+    }
+    return out;
+}
+
+/* Writer side ------------------------------------------------------------------------------------------- */
+
+#ifdef AOS_HOST
+
+static void* Capture_writer(void* data) {
+    Capture* capture = data;
+
+    pthread_mutex_lock(&capture->lock);
+    for (;;) {
+        while (!capture->queued && !capture->quit) {
+            pthread_cond_wait(&capture->wake, &capture->lock);
+        }
+        if (!capture->queued) {
+            break;
+        }
+
+        CaptureBuffer* buffer = &capture->buffers[capture->queue[0]];
+        capture->queue[0] = capture->queue[1];
+        capture->queued--;
+        pthread_mutex_unlock(&capture->lock);
+
+        if (fwrite(buffer->data, 1, buffer->used, capture->file) != buffer->used) {
+            capture->writeErrors++;
+        }
+
+        pthread_mutex_lock(&capture->lock);
+        buffer->busy = FALSE;
+        pthread_cond_broadcast(&capture->wake);
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+static int Capture_startWriter(Capture* capture, const char* path) {
+    if (!(capture->file = fopen(path, "wb"))) {
+        return FALSE;
+    }
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->wake, NULL);
+    capture->queued = 0;
+    capture->quit = FALSE;
+    if (pthread_create(&capture->thread, NULL, Capture_writer, capture) != 0) {
+        fclose(capture->file);
+        capture->file = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void Capture_submit(Capture* capture, CaptureBuffer* buffer) {
+    pthread_mutex_lock(&capture->lock);
+    buffer->busy = TRUE;
+    capture->queue[capture->queued++] = (int) (buffer - capture->buffers);
+    pthread_cond_broadcast(&capture->wake);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/* The writer clears 'busy' itself, taking the lock just makes sure we see it */
+static void Capture_poll(Capture* capture) {
+    pthread_mutex_lock(&capture->lock);
+    pthread_mutex_unlock(&capture->lock);
+}
+
+static void Capture_waitIdle(Capture* capture) {
+    pthread_mutex_lock(&capture->lock);
+    while (capture->buffers[0].busy || capture->buffers[1].busy) {
+        pthread_cond_wait(&capture->wake, &capture->lock);
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+static void Capture_stopWriter(Capture* capture) {
+    pthread_mutex_lock(&capture->lock);
+    capture->quit = TRUE;
+    pthread_cond_broadcast(&capture->wake);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+    pthread_cond_destroy(&capture->wake);
+    pthread_mutex_destroy(&capture->lock);
+    fclose(capture->file);
+    capture->file = 0;
+}
+
+#else
+
+/* The writer process finds its Capture here, only one capture runs at a time */
+static Capture* captureWriterTarget;
+
+static void Capture_writer(void) {
+    Capture* capture = captureWriterTarget;
+    struct MsgPort* port = CreateMsgPort();
+
+    capture->writerPort = port;
+    Signal(capture->mainTask, SIGBREAKF_CTRL_F);
+    if (!port) {
+        return;
+    }
+
+    for (;;) {
+        CaptureBuffer* buffer;
+
+        WaitPort(port);
+        while ((buffer = (CaptureBuffer*) GetMsg(port))) {
+            if (!buffer->data) {
+                DeleteMsgPort(port);
+                /* stays forbidden until this process has gone, the code belongs to the main program */
+                Forbid();
+                ReplyMsg(&buffer->msg);
+                return;
+            }
+
+            if (Write(capture->file, buffer->data, (LONG) buffer->used) != (LONG) buffer->used) {
+                capture->writeErrors++;
+            }
+            ReplyMsg(&buffer->msg);
+        }
+    }
+}
+
+static int Capture_startWriter(Capture* capture, const char* path) {
+    if (!(capture->file = Open((CONST_STRPTR) path, MODE_NEWFILE))) {
+        return FALSE;
+    }
+
+    if (!(capture->replyPort = CreateMsgPort())) {
+        Close(capture->file);
+        capture->file = 0;
+        return FALSE;
+    }
+
+    captureWriterTarget = capture;
+    capture->mainTask = FindTask(NULL);
+    capture->writerPort = NULL;
+    SetSignal(0, SIGBREAKF_CTRL_F);
+
+    if (CreateNewProcTags(NP_Entry, (ULONG) Capture_writer,
+                          NP_Name, (ULONG) "capture writer",
+                          NP_Priority, 1,
+                          TAG_DONE)) {
+        Wait(SIGBREAKF_CTRL_F);
+    }
+
+    if (!capture->writerPort) {
+        DeleteMsgPort(capture->replyPort);
+        capture->replyPort = 0;
+        Close(capture->file);
+        capture->file = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void Capture_submit(Capture* capture, CaptureBuffer* buffer) {
+    buffer->busy = TRUE;
+    buffer->msg.mn_ReplyPort = capture->replyPort;
+    buffer->msg.mn_Length = sizeof(CaptureBuffer);
+    PutMsg(capture->writerPort, &buffer->msg);
+}
+
+/* Collect buffers the writer has finished with, never waits */
+static void Capture_poll(Capture* capture) {
+    CaptureBuffer* buffer;
+    while ((buffer = (CaptureBuffer*) GetMsg(capture->replyPort))) {
+        buffer->busy = FALSE;
+    }
+}
+
+static void Capture_waitIdle(Capture* capture) {
+    Capture_poll(capture);
+    while (capture->buffers[0].busy || capture->buffers[1].busy) {
+        WaitPort(capture->replyPort);
+        Capture_poll(capture);
+    }
+}
+
+static void Capture_stopWriter(Capture* capture) {
+    capture->quitMsg.data = NULL;
+    Capture_submit(capture, &capture->quitMsg);
+    while (capture->quitMsg.busy) {
+        WaitPort(capture->replyPort);
+        Capture_poll(capture);
+    }
+    DeleteMsgPort(capture->replyPort);
+    capture->replyPort = 0;
+    Close(capture->file);
+    capture->file = 0;
+}
+
+#endif
+
+/* Main loop side ---------------------------------------------------------------------------------------- */
+
+static void Capture_freeBuffers(Capture* capture) {
+    Mem_free(capture->previous);
+    Mem_free(capture->scratch);
+    Mem_free(capture->buffers[0].data);
+    Mem_free(capture->buffers[1].data);
+    capture->previous = 0;
+    capture->scratch = 0;
+    capture->buffers[0].data = 0;
+    capture->buffers[1].data = 0;
+}
+
+/* Close timer.device if Capture_open() opened it */
+static void Capture_closeTimer(Capture* capture) {
+#ifndef AOS_HOST
+    if (capture->timer.io_Device) {
+        CloseDevice(&capture->timer);
+        capture->timer.io_Device = NULL;
+        TimerBase = NULL;
+    }
+#else
+    (void) capture;
+#endif
+}
+
+/* 'depth' is ignored for CAPTURE_CHUNKY */
+static int Capture_open(Capture* capture, const char* path, int width, int height, int format, int depth) {
+    memset(capture, 0, sizeof(*capture));
+
+    capture->width = width;
+    capture->height = height;
+    capture->format = format;
+    capture->depth = format == CAPTURE_CHUNKY ? 8 : (depth > CAPTURE_MAX_PLANES ? CAPTURE_MAX_PLANES : depth);
+    capture->rowBytes = format == CAPTURE_CHUNKY ? width : (width + 7) >> 3;
+    capture->numRows = format == CAPTURE_CHUNKY ? height : height * capture->depth;
+    capture->worstFrame = 16 + capture->numRows * (5 + capture->rowBytes + capture->rowBytes / 128 + 1);
+    capture->bufferSize = capture->worstFrame + CAPTURE_FLUSH_SIZE + 1024;
+
+    capture->previous = Mem_alloc(capture->numRows * capture->rowBytes, MEM_FOR_CPU, TRUE);
+    capture->scratch = Mem_alloc(capture->rowBytes, MEM_FOR_CPU, FALSE);
+    capture->buffers[0].data = Mem_alloc(capture->bufferSize, MEM_FOR_CPU, FALSE);
+    capture->buffers[1].data = Mem_alloc(capture->bufferSize, MEM_FOR_CPU, FALSE);
+
+#ifndef AOS_HOST
+    if (!TimerBase) {
+        if (OpenDevice((CONST_STRPTR) "timer.device", UNIT_MICROHZ, &capture->timer, 0) != 0) {
+            capture->timer.io_Device = NULL;
+            printf("Can't open timer.device to time the capture\n");
+            Capture_freeBuffers(capture);
+            return FALSE;
+        }
+        TimerBase = capture->timer.io_Device;
+    }
+#endif
+
+    if (!capture->previous || !capture->scratch || !capture->buffers[0].data || !capture->buffers[1].data) {
+        Capture_freeBuffers(capture);
+        Capture_closeTimer(capture);
+        return FALSE;
+    }
+
+    if (!Capture_startWriter(capture, path)) {
+        printf("Can't open capture file %s\n", path);
+        Capture_freeBuffers(capture);
+        Capture_closeTimer(capture);
+        return FALSE;
+    }
+
+    unsigned char* out = capture->buffers[0].data;
+    memcpy(out, "AOSC", 4);
+    out[4] = CAPTURE_VERSION;
+    out[5] = (unsigned char) (width >> 8);
+    out[6] = (unsigned char) width;
+    out[7] = (unsigned char) (height >> 8);
+    out[8] = (unsigned char) height;
+    out[9] = (unsigned char) format;
+    out[10] = (unsigned char) capture->depth;
+    capture->buffers[0].used = 11;
+    capture->start = Startup_now(&capture->ticksPerSecond);
+    return TRUE;
+}
+
+static inline int Capture_isOpen(const Capture* capture) {
+    return capture->file != 0;
+}
+
+/*
+ * Make room for 'bytes' in the current buffer, handing it to the writer if needed.  Returns FALSE when both
+ * buffers are taken, the caller drops what it wanted to write.
+ */
+static int Capture_reserve(Capture* capture, unsigned long bytes) {
+    CaptureBuffer* buffer = &capture->buffers[capture->current];
+    CaptureBuffer* other = &capture->buffers[capture->current ^ 1];
+
+    Capture_poll(capture);
+
+    if (buffer->used + bytes <= capture->bufferSize) {
+        return TRUE;
+    }
+    if (other->busy) {
+        return FALSE;
+    }
+
+    Capture_submit(capture, buffer);
+    capture->current ^= 1;
+    other->used = 0;
+    return TRUE;
+}
+
+/* Hand the current buffer over early once it's worth a write and the writer is free */
+static void Capture_flushIfIdle(Capture* capture) {
+    CaptureBuffer* buffer = &capture->buffers[capture->current];
+    CaptureBuffer* other = &capture->buffers[capture->current ^ 1];
+
+    if (buffer->used >= CAPTURE_FLUSH_SIZE && !other->busy) {
+        Capture_submit(capture, buffer);
+        capture->current ^= 1;
+        other->used = 0;
+    }
+}
+
+/* Record palette entries that changed since the last call, colours are 0xRRGGBB */
+static void Capture_setPalette(Capture* capture, const unsigned long* colours, int numColours) {
+    int first = -1;
+    int last = -1;
+
+    if (!Capture_isOpen(capture)) {
+        return;
+    }
+    if (numColours > 256) {
+        numColours = 256;
+    }
+
+    for (int i = 0; i < numColours; i++) {
+        if (!capture->paletteValid || capture->palette[i] != colours[i]) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+
+    if (first < 0 || !Capture_reserve(capture, 11 + (last - first + 1) * 3)) {
+        return;
+    }
+
+    CaptureBuffer* buffer = &capture->buffers[capture->current];
+    unsigned char* out = buffer->data + buffer->used;
+    *out++ = CAPTURE_REC_PALETTE;
+    out = Capture_putVar(out, first);
+    out = Capture_putVar(out, last - first + 1);
+    for (int i = first; i <= last; i++) {
+        *out++ = (unsigned char) (colours[i] >> 16);
+        *out++ = (unsigned char) (colours[i] >> 8);
+        *out++ = (unsigned char) colours[i];
+        capture->palette[i] = colours[i];
+    }
+    buffer->used = out - buffer->data;
+    capture->paletteValid = TRUE;
+}
+
+/*
+ * Record a frame.  'planes' is the chunky buffer (CAPTURE_CHUNKY, pass &buffer) or the bitplanes
+ * (CAPTURE_PLANAR), 'bytesPerRow' their modulo.  Cost is a compare per row plus encoding the changed ones.
+ */
+static void Capture_frame(Capture* capture, unsigned char** planes, int bytesPerRow) {
+    int numPlanes = capture->format == CAPTURE_CHUNKY ? 1 : capture->depth;
+    int rowBytes = capture->rowBytes;
+
+    if (!Capture_isOpen(capture)) {
+        return;
+    }
+
+    capture->frame++;
+    capture->bytesIn += (unsigned long) capture->numRows * rowBytes;
+
+    if (!Capture_reserve(capture, capture->worstFrame)) {
+        capture->dropped++;
+        return;
+    }
+
+    CaptureBuffer* buffer = &capture->buffers[capture->current];
+    unsigned char* out = buffer->data + buffer->used;
+    unsigned long ticksPerSecond;
+    unsigned long ms = (unsigned long) ((Startup_now(&ticksPerSecond) - capture->start) * 1000 /
+                                        capture->ticksPerSecond);
+    int numChanged = 0;
+    int nextRow = 0;
+    int row = 0;
+
+    *out++ = CAPTURE_REC_FRAME;
+    out = Capture_putVar(out, capture->frame - capture->lastFrame);
+    out = Capture_putVar(out, ms - capture->lastMs);
+    unsigned char* numChangedOut = out;
+    out += 2;
+
+    for (int p = 0; p < numPlanes; p++) {
+        const unsigned char* src = planes[p];
+        for (int y = 0; y < capture->height; y++, row++, src += bytesPerRow) {
+            unsigned char* old = capture->previous + row * rowBytes;
+            if (memcmp(src, old, rowBytes) == 0) {
+                continue;
+            }
+
+            for (int i = 0; i < rowBytes; i++) {
+                capture->scratch[i] = src[i] ^ old[i];
+            }
+            memcpy(old, src, rowBytes);
+
+            out = Capture_putVar(out, row - nextRow);
+            out = Capture_byteRun1(out, capture->scratch, rowBytes);
+            nextRow = row + 1;
+            numChanged++;
+        }
+    }
+
+    numChangedOut[0] = (unsigned char) (numChanged >> 8);
+    numChangedOut[1] = (unsigned char) numChanged;
+
+    capture->bytesOut += (out - buffer->data) - buffer->used;
+    buffer->used = out - buffer->data;
+    capture->lastFrame = capture->frame;
+    capture->lastMs = ms;
+    capture->framesRecorded++;
+    capture->rowsChanged += numChanged;
+
+    Capture_flushIfIdle(capture);
+}
+
+static void Capture_close(Capture* capture) {
+    if (!Capture_isOpen(capture)) {
+        return;
+    }
+
+    Capture_waitIdle(capture);
+    Capture_reserve(capture, 1);
+    CaptureBuffer* buffer = &capture->buffers[capture->current];
+    buffer->data[buffer->used++] = CAPTURE_REC_END;
+    Capture_submit(capture, buffer);
+    Capture_waitIdle(capture);
+    Capture_stopWriter(capture);
+
+    printf("captured %lu of %lu frames (%lu dropped), %lu rows changed, %lu KB in, %lu KB out, %lu write errors\n",
+           capture->framesRecorded, capture->frame, capture->dropped, capture->rowsChanged,
+           capture->bytesIn / 1024, capture->bytesOut / 1024, capture->writeErrors);
+
+    Capture_freeBuffers(capture);
+    Capture_closeTimer(capture);
+}
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef AOS_COMMON_COPPER_H
+#define AOS_COMMON_COPPER_H
+
+#include "platform.h"
+#include "memory.h"
+
+#ifndef AOS_HOST
+#include <exec/memory.h>
+#include <graphics/gfxmacros.h>
+#include <graphics/copper.h>
+#include <hardware/custom.h>
+#include <intuition/screens.h>
+#include <clib/exec_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/intuition_protos.h>
+
+extern struct Custom custom;
+#endif
+
+/*
+ * Per-scanline colour changes through a user copper list (UCopList).
+ *
+ * The copper rewrites colour registers as the beam passes each line, so gradients and raster bars cost no CPU
+ * time per frame once the list is installed.  Changes are kept sorted by line, CopperFx_set() only marks the
+ * effect dirty when something actually changed and CopperFx_commit() only rebuilds and installs a new copper
+ * list when dirty.  A static effect is built once; an animated one costs one list rebuild per frame it
+ * changes, not per-line CPU work.
+ *
+ * Colours are 12 bit (0x0RGB) values as written to the COLORxx registers.  Lines are relative to the top of
+ * the screen's ViewPort.
+ *
+ * On the host CopperFx_emulate() produces the palette in effect on every line so effects can be checked
+ * without a display.
+ */
+
+typedef struct sCopperChange {
+    short line;
+    unsigned short reg;
+    unsigned short rgb;
+} CopperChange;
+
+typedef struct sCopperFx {
+    CopperChange* changes;
+    int numChanges;
+    int maxChanges;
+    int height;
+    int dirty;
+    int rebuilds;
+#ifndef AOS_HOST
+    struct Screen* screen;
+#endif
+} CopperFx;
+
+#ifdef AOS_HOST
+static int CopperFx_init(CopperFx* fx, int height, int maxChanges) {
+#else
+static int CopperFx_init(CopperFx* fx, struct Screen* screen, int height, int maxChanges) {
+    fx->screen = screen;
+#endif
+    fx->height = height;
+    fx->maxChanges = maxChanges;
+    fx->numChanges = 0;
+    fx->dirty = FALSE;
+    fx->rebuilds = 0;
+    fx->changes = Mem_alloc(maxChanges * sizeof(CopperChange), MEM_FOR_CPU, FALSE);
+    return fx->changes != 0;
+}
+
+/* The installed copper list belongs to the screen now, CloseScreen() frees it */
+static void CopperFx_free(CopperFx* fx) {
+    Mem_free(fx->changes);
+    fx->changes = 0;
+}
+
+/* Remove all changes, the next commit installs an empty list */
+static void CopperFx_clear(CopperFx* fx) {
+    if (fx->numChanges) {
+        fx->numChanges = 0;
+        fx->dirty = TRUE;
+    }
+}
+
+/* Set colour register 'reg' to 'rgb' from 'line' downwards.  Returns FALSE when out of space. */
+static int CopperFx_set(CopperFx* fx, int line, int reg, unsigned short rgb) {
+    if (line < 0 || line >= fx->height) {
+        return TRUE;
+    }
+
+    int i = fx->numChanges;
+    while (i > 0 && (fx->changes[i - 1].line > line ||
+                     (fx->changes[i - 1].line == line && fx->changes[i - 1].reg > reg))) {
+        i--;
+    }
+
+    if (i > 0 && fx->changes[i - 1].line == line && fx->changes[i - 1].reg == reg) {
+        if (fx->changes[i - 1].rgb != rgb) {
+            fx->changes[i - 1].rgb = rgb;
+            fx->dirty = TRUE;
+        }
+        return TRUE;
+    }
+
+    if (fx->numChanges == fx->maxChanges) {
+        return FALSE;
+    }
+
+    for (int j = fx->numChanges; j > i; j--) {
+        fx->changes[j] = fx->changes[j - 1];
+    }
+
+    fx->changes[i].line = (short) line;
+    fx->changes[i].reg = (unsigned short) reg;
+    fx->changes[i].rgb = rgb;
+    fx->numChanges++;
+    fx->dirty = TRUE;
+    return TRUE;
+}
+
+/* Linear 12 bit gradient on one colour register, one change per line where the colour actually steps */
+static int CopperFx_gradient(CopperFx* fx, int fromLine, int toLine, int reg, unsigned short fromRgb,
+                             unsigned short toRgb) {
+    int lines = toLine - fromLine;
+    unsigned short prev = 0xffff;
+
+    for (int line = fromLine; line <= toLine; line++) {
+        int t = lines > 0 ? ((line - fromLine) << 8) / lines : 0;
+        unsigned short rgb = 0;
+        for (int shift = 0; shift < 12; shift += 4) {
+            int from = (fromRgb >> shift) & 0xf;
+            int to = (toRgb >> shift) & 0xf;
+            rgb |= (unsigned short) ((from + (((to - from) * t) >> 8)) << shift);
+        }
+
+        if (rgb != prev && !CopperFx_set(fx, line, reg, rgb)) {
+            return FALSE;
+        }
+        prev = rgb;
+    }
+    return TRUE;
+}
+
+#ifndef AOS_HOST
+/* Build and install a new copper list if the effect changed since the last commit */
+static int CopperFx_commit(CopperFx* fx) {
+    if (!fx->dirty) {
+        return TRUE;
+    }
+
+    struct UCopList* ucl = AllocMem(sizeof(struct UCopList), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!ucl) {
+        return FALSE;
+    }
+
+    /* One wait per line with changes, one move per change and the end */
+    CINIT(ucl, fx->numChanges * 2 + 1);
+
+    int line = -1;
+    for (int i = 0; i < fx->numChanges; i++) {
+        CopperChange* change = &fx->changes[i];
+        if (change->line != line) {
+            line = change->line;
+            CWAIT(ucl, line, 0);
+        }
+        CMOVE(ucl, custom.color[change->reg], change->rgb);
+    }
+    CEND(ucl);
+
+    struct ViewPort* viewPort = &fx->screen->ViewPort;
+
+    Forbid();
+    struct UCopList* old = viewPort->UCopIns;
+    viewPort->UCopIns = ucl;
+    Permit();
+
+    RethinkDisplay();
+
+    if (old) {
+        FreeCopList(old->FirstCopList);
+        FreeMem(old, sizeof(struct UCopList));
+    }
+
+    fx->dirty = FALSE;
+    fx->rebuilds++;
+    return TRUE;
+}
+#endif
+
+/*
+ * Emulate the copper: fill 'out' (height * numColours entries) with the palette in effect on every line,
+ * starting from 'base' at the top of the screen.
+ */
+static void CopperFx_emulate(const CopperFx* fx, const unsigned short* base, int numColours, unsigned short* out) {
+    int next = 0;
+
+    for (int line = 0; line < fx->height; line++) {
+        unsigned short* palette = out + line * numColours;
+        const unsigned short* prev = line ? palette - numColours : base;
+
+        for (int i = 0; i < numColours; i++) {
+            palette[i] = prev[i];
+        }
+
+        while (next < fx->numChanges && fx->changes[next].line == line) {
+            if (fx->changes[next].reg < numColours) {
+                palette[fx->changes[next].reg] = fx->changes[next].rgb;
+            }
+            next++;
+        }
+    }
+}
+
+#endif
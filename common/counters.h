@@ -0,0 +1,150 @@
+#ifndef AOS_COMMON_COUNTERS_H
+#define AOS_COMMON_COUNTERS_H
+
+#include "platform.h"
+
+/*
+ * Per frame counts of the graphics calls on the hot paths, compiled in with -DAOS_COUNTERS.
+ *
+ * Demos call the Counters_ wrappers instead of WritePixel() / SetAPen() / RectFill() / LockBitMapTags() /
+ * UnLockBitMap() / ChangeScreenBuffer(), add Counters_pixels() / Counters_bytes() to loops writing memory
+ * directly, and call Counters_endFrame() once per frame.  Counters_print() lists totals, per frame averages
+ * and the worst frame for each, next to the rest of the timing report.
+ *
+ * Without AOS_COUNTERS the wrappers are the plain calls and everything else is an empty statement, so there
+ * is nothing left of this in a normal build.  Lock times need timer.device open (TimerBase, common/startup.h).
+ */
+
+#define COUNTER_WRITEPIXEL 0
+#define COUNTER_SETAPEN 1
+#define COUNTER_RECTFILL 2
+#define COUNTER_LOCKBITMAP 3
+#define COUNTER_CHANGESCREENBUFFER 4
+#define COUNTER_NUM_CALLS 5
+
+#ifdef AOS_COUNTERS
+
+#include <stdio.h>
+
+#include "startup.h"
+
+typedef struct sCounterFrame {
+    unsigned long calls[COUNTER_NUM_CALLS];
+    unsigned long pixels;               /* pixels drawn by the calls or by direct writes */
+    unsigned long bytes;                /* bytes written directly into bitmaps */
+    unsigned long long lockTicks;       /* time spent with a bitmap locked */
+} CounterFrame;
+
+typedef struct sCounters {
+    CounterFrame frame;
+    CounterFrame total;
+    CounterFrame peak;
+    unsigned long frames;
+    unsigned long long lockStart;
+    unsigned long ticksPerSecond;
+} Counters;
+
+static Counters aosCounters;
+
+static const char* Counters_names[COUNTER_NUM_CALLS] = {
+        "WritePixel", "SetAPen", "RectFill", "LockBitMapTags", "ChangeScreenBuffer"
+};
+
+#define Counters_call(counter) (aosCounters.frame.calls[counter]++)
+
+#define Counters_WritePixel(rastPort, x, y) \
+    (Counters_call(COUNTER_WRITEPIXEL), aosCounters.frame.pixels++, WritePixel(rastPort, x, y))
+
+#define Counters_SetAPen(rastPort, pen) (Counters_call(COUNTER_SETAPEN), SetAPen(rastPort, pen))
+
+#define Counters_RectFill(rastPort, x0, y0, x1, y1) \
+    (Counters_call(COUNTER_RECTFILL), \
+     aosCounters.frame.pixels += (unsigned long) ((x1) - (x0) + 1) * ((y1) - (y0) + 1), \
+     RectFill(rastPort, x0, y0, x1, y1))
+
+#define Counters_LockBitMapTags(bitMap, ...) \
+    (Counters_call(COUNTER_LOCKBITMAP), aosCounters.lockStart = Startup_now(&aosCounters.ticksPerSecond), \
+     LockBitMapTags(bitMap, __VA_ARGS__))
+
+#define Counters_UnLockBitMap(handle) \
+    (UnLockBitMap(handle), \
+     aosCounters.frame.lockTicks += Startup_now(&aosCounters.ticksPerSecond) - aosCounters.lockStart)
+
+#define Counters_ChangeScreenBuffer(screen, buffer) \
+    (Counters_call(COUNTER_CHANGESCREENBUFFER), ChangeScreenBuffer(screen, buffer))
+
+#define Counters_pixels(count) (aosCounters.frame.pixels += (count))
+#define Counters_bytes(count) (aosCounters.frame.bytes += (count))
+
+static void Counters_endFrame() {
+    CounterFrame* frame = &aosCounters.frame;
+    CounterFrame* total = &aosCounters.total;
+    CounterFrame* peak = &aosCounters.peak;
+
+    for (int i = 0; i < COUNTER_NUM_CALLS; i++) {
+        total->calls[i] += frame->calls[i];
+        if (frame->calls[i] > peak->calls[i]) {
+            peak->calls[i] = frame->calls[i];
+        }
+        frame->calls[i] = 0;
+    }
+
+    total->pixels += frame->pixels;
+    total->bytes += frame->bytes;
+    total->lockTicks += frame->lockTicks;
+    if (frame->pixels > peak->pixels) {
+        peak->pixels = frame->pixels;
+    }
+    if (frame->bytes > peak->bytes) {
+        peak->bytes = frame->bytes;
+    }
+    if (frame->lockTicks > peak->lockTicks) {
+        peak->lockTicks = frame->lockTicks;
+    }
+    frame->pixels = 0;
+    frame->bytes = 0;
+    frame->lockTicks = 0;
+
+    aosCounters.frames++;
+}
+
+static unsigned long Counters_micros(unsigned long long ticks) {
+    return aosCounters.ticksPerSecond ? (unsigned long) (ticks * 1000000 / aosCounters.ticksPerSecond) : 0;
+}
+
+static void Counters_print() {
+    unsigned long frames = aosCounters.frames ? aosCounters.frames : 1;
+    CounterFrame* total = &aosCounters.total;
+    CounterFrame* peak = &aosCounters.peak;
+
+    printf("counters over %lu frames:      total  per frame   worst\n", aosCounters.frames);
+    for (int i = 0; i < COUNTER_NUM_CALLS; i++) {
+        if (total->calls[i]) {
+            printf("  %-22s %10lu %10lu %7lu\n", Counters_names[i], total->calls[i], total->calls[i] / frames,
+                   peak->calls[i]);
+        }
+    }
+    printf("  %-22s %10lu %10lu %7lu\n", "pixels", total->pixels, total->pixels / frames, peak->pixels);
+    printf("  %-22s %10lu %10lu %7lu\n", "bytes written", total->bytes, total->bytes / frames, peak->bytes);
+    if (total->lockTicks) {
+        printf("  %-22s %10lu %10lu %7lu\n", "locked us", Counters_micros(total->lockTicks),
+               Counters_micros(total->lockTicks / frames), Counters_micros(peak->lockTicks));
+    }
+}
+
+#else
+
+#define Counters_WritePixel(rastPort, x, y) WritePixel(rastPort, x, y)
+#define Counters_SetAPen(rastPort, pen) SetAPen(rastPort, pen)
+#define Counters_RectFill(rastPort, x0, y0, x1, y1) RectFill(rastPort, x0, y0, x1, y1)
+#define Counters_LockBitMapTags(bitMap, ...) LockBitMapTags(bitMap, __VA_ARGS__)
+#define Counters_UnLockBitMap(handle) UnLockBitMap(handle)
+#define Counters_ChangeScreenBuffer(screen, buffer) ChangeScreenBuffer(screen, buffer)
+#define Counters_pixels(count) ((void) 0)
+#define Counters_bytes(count) ((void) 0)
+#define Counters_endFrame() ((void) 0)
+#define Counters_print() ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef AOS_COMMON_FLOCK_H
+#define AOS_COMMON_FLOCK_H
+
+#include "platform.h"
+#include "memory.h"
+#include "grid.h"
+
+/*
+ * Flocking insects: separation, alignment and cohesion from neighbours found through a SpatialGrid.
+ *
+ * Positions and velocities are 16.16 fixed point, kept as separate arrays so the grid build reads x / y
+ * straight through.  Steering weights are shifts and the speed limit uses the octagonal |v| estimate
+ * (max + min / 2), so the only division per insect is the average of its neighbours and the occasional
+ * speed clamp.  New velocities go to a second pair of arrays so every insect sees last frame's flock.
+ *
+ * Each insect looks at no more than FLOCK_MAX_NEIGHBOURS others, which bounds the work when they bunch up.
+ */
+
+#define FLOCK_MAX_NEIGHBOURS 16
+
+typedef struct sFlock {
+    int count;
+    int capacity;
+    int width;                  /* pixels */
+    int height;
+    long* x;
+    long* y;
+    long* dx;
+    long* dy;
+    long* newDx;
+    long* newDy;
+
+    int radius;                 /* pixels, neighbours for alignment / cohesion */
+    int separation;             /* pixels, neighbours closer than this are pushed away from */
+    long minSpeed;              /* 16.16 pixels per frame */
+    long maxSpeed;
+    int cohesionShift;          /* steering weights, bigger is weaker */
+    int alignmentShift;
+    int separationShift;
+    int edgeMargin;             /* pixels, insects closer to an edge are turned back */
+    long edgeTurn;
+
+    SpatialGrid grid;
+    unsigned long neighbours;   /* neighbours used in the last update */
+} Flock;
+
+static void Flock_free(Flock* flock) {
+    Mem_free(flock->x);
+    Mem_free(flock->y);
+    Mem_free(flock->dx);
+    Mem_free(flock->dy);
+    Mem_free(flock->newDx);
+    Mem_free(flock->newDy);
+    flock->x = 0;
+    flock->y = 0;
+    flock->dx = 0;
+    flock->dy = 0;
+    flock->newDx = 0;
+    flock->newDy = 0;
+    SpatialGrid_free(&flock->grid);
+}
+
+static int Flock_init(Flock* flock, int capacity, int width, int height, int radius) {
+    int cellShift = 0;
+    while ((1 << (cellShift + 1)) <= radius) {
+        cellShift++;
+    }
+
+    flock->count = 0;
+    flock->capacity = capacity;
+    flock->width = width;
+    flock->height = height;
+    flock->radius = radius;
+    flock->separation = radius / 3;
+    flock->minSpeed = 1 << 16;
+    flock->maxSpeed = 3 << 16;
+    flock->cohesionShift = 7;
+    flock->alignmentShift = 3;
+    flock->separationShift = 2;
+    flock->edgeMargin = radius;
+    flock->edgeTurn = 1 << 14;
+    flock->neighbours = 0;
+
+    flock->x = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    flock->y = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    flock->dx = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    flock->dy = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    flock->newDx = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    flock->newDy = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+
+    if (!SpatialGrid_init(&flock->grid, width, height, cellShift, capacity) ||
+        !flock->x || !flock->y || !flock->dx || !flock->dy || !flock->newDx || !flock->newDy) {
+        Flock_free(flock);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* 16.16 position and velocity */
+static int Flock_add(Flock* flock, long x, long y, long dx, long dy) {
+    if (flock->count == flock->capacity) {
+        return FALSE;
+    }
+    flock->x[flock->count] = x;
+    flock->y[flock->count] = y;
+    flock->dx[flock->count] = dx;
+    flock->dy[flock->count] = dy;
+    flock->count++;
+    return TRUE;
+}
+
+static inline long Flock_abs(long v) {
+    return v < 0 ? -v : v;
+}
+
+static void Flock_update(Flock* flock) {
+    unsigned short found[FLOCK_MAX_NEIGHBOURS + 1];
+    long separation16 = (long) flock->separation << 16;
+    long edge0 = (long) flock->edgeMargin << 16;
+    long edgeX1 = (long) (flock->width - flock->edgeMargin) << 16;
+    long edgeY1 = (long) (flock->height - flock->edgeMargin) << 16;
+    long maxX = ((long) flock->width << 16) - 1;
+    long maxY = ((long) flock->height << 16) - 1;
+
+    SpatialGrid_build(&flock->grid, flock->x, flock->y, flock->count);
+    flock->neighbours = 0;
+
+    for (int i = 0; i < flock->count; i++) {
+        long x = flock->x[i];
+        long y = flock->y[i];
+        long dx = flock->dx[i];
+        long dy = flock->dy[i];
+
+        /* +1 as the insect finds itself */
+        int numFound = SpatialGrid_query(&flock->grid, x, y, flock->radius, found, FLOCK_MAX_NEIGHBOURS + 1);
+
+        long sumX = 0, sumY = 0, sumDx = 0, sumDy = 0, pushX = 0, pushY = 0;
+        int numNeighbours = 0;
+
+        for (int n = 0; n < numFound; n++) {
+            int j = found[n];
+            if (j == i) {
+                continue;
+            }
+
+            long offX = flock->x[j] - x;
+            long offY = flock->y[j] - y;
+            sumX += offX;
+            sumY += offY;
+            sumDx += flock->dx[j];
+            sumDy += flock->dy[j];
+            numNeighbours++;
+
+            if (Flock_abs(offX) < separation16 && Flock_abs(offY) < separation16) {
+                pushX -= offX;
+                pushY -= offY;
+            }
+        }
+
+        if (numNeighbours) {
+            /* cohesion: towards the middle of the neighbours, alignment: towards their average heading */
+            dx += (sumX / numNeighbours) >> flock->cohesionShift;
+            dy += (sumY / numNeighbours) >> flock->cohesionShift;
+            dx += (sumDx / numNeighbours - dx) >> flock->alignmentShift;
+            dy += (sumDy / numNeighbours - dy) >> flock->alignmentShift;
+            dx += pushX >> (flock->separationShift + 4);
+            dy += pushY >> (flock->separationShift + 4);
+            flock->neighbours += numNeighbours;
+        }
+
+        if (x < edge0) {
+            dx += flock->edgeTurn;
+        } else if (x > edgeX1) {
+            dx -= flock->edgeTurn;
+        }
+        if (y < edge0) {
+            dy += flock->edgeTurn;
+        } else if (y > edgeY1) {
+            dy -= flock->edgeTurn;
+        }
+
+        long ax = Flock_abs(dx);
+        long ay = Flock_abs(dy);
+        long speed = ax > ay ? ax + (ay >> 1) : ay + (ax >> 1);
+        if (speed > flock->maxSpeed || (speed < flock->minSpeed && speed >= flock->minSpeed >> 3)) {
+            long target = speed > flock->maxSpeed ? flock->maxSpeed : flock->minSpeed;
+            long scale = (target >> 4) * 256 / (speed >> 4);      /* 8.8, at most 8.0 */
+            dx = ((dx >> 4) * scale) >> 4;
+            dy = ((dy >> 4) * scale) >> 4;
+        } else if (speed < flock->minSpeed) {
+            /* too slow to scale up accurately, restart along the x direction */
+            dx = dx < 0 ? -flock->minSpeed : flock->minSpeed;
+        }
+
+        flock->newDx[i] = dx;
+        flock->newDy[i] = dy;
+    }
+
+    for (int i = 0; i < flock->count; i++) {
+        long x = flock->x[i] + flock->newDx[i];
+        long y = flock->y[i] + flock->newDy[i];
+
+        if (x < 0) {
+            x = 0;
+        } else if (x > maxX) {
+            x = maxX;
+        }
+        if (y < 0) {
+            y = 0;
+        } else if (y > maxY) {
+            y = maxY;
+        }
+
+        flock->x[i] = x;
+        flock->y[i] = y;
+        flock->dx[i] = flock->newDx[i];
+        flock->dy[i] = flock->newDy[i];
+    }
+}
+
+#endif
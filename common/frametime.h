@@ -0,0 +1,106 @@
+#ifndef AOS_COMMON_FRAMETIME_H
+#define AOS_COMMON_FRAMETIME_H
+
+#include <stdlib.h>
+
+#include "platform.h"
+#include "memory.h"
+
+/*
+ * Frame time history in microseconds.
+ *
+ * Keeps the last 'capacity' frame times in a ring.  Averages are kept up to date as frames are added,
+ * percentiles sort a copy so only ask for them in reports, not every frame.
+ */
+
+typedef struct sFrameTimes {
+    unsigned long* times;
+    unsigned long* sorted;
+    int capacity;
+    int count;              /* valid entries, up to capacity */
+    int next;
+    unsigned long total;    /* sum of the valid entries */
+    unsigned long frames;   /* frames added since the last reset */
+} FrameTimes;
+
+static int FrameTimes_init(FrameTimes* frameTimes, int capacity) {
+    frameTimes->capacity = capacity;
+    frameTimes->count = 0;
+    frameTimes->next = 0;
+    frameTimes->total = 0;
+    frameTimes->frames = 0;
+    frameTimes->times = Mem_alloc(capacity * sizeof(unsigned long), MEM_FOR_CPU, FALSE);
+    frameTimes->sorted = Mem_alloc(capacity * sizeof(unsigned long), MEM_FOR_CPU, FALSE);
+    return frameTimes->times && frameTimes->sorted;
+}
+
+static void FrameTimes_free(FrameTimes* frameTimes) {
+    Mem_free(frameTimes->times);
+    Mem_free(frameTimes->sorted);
+    frameTimes->times = 0;
+    frameTimes->sorted = 0;
+}
+
+static inline void FrameTimes_reset(FrameTimes* frameTimes) {
+    frameTimes->count = 0;
+    frameTimes->next = 0;
+    frameTimes->total = 0;
+    frameTimes->frames = 0;
+}
+
+static inline void FrameTimes_add(FrameTimes* frameTimes, unsigned long micros) {
+    if (frameTimes->count == frameTimes->capacity) {
+        frameTimes->total -= frameTimes->times[frameTimes->next];
+    } else {
+        frameTimes->count++;
+    }
+
+    frameTimes->times[frameTimes->next] = micros;
+    frameTimes->total += micros;
+    frameTimes->frames++;
+
+    if (++frameTimes->next == frameTimes->capacity) {
+        frameTimes->next = 0;
+    }
+}
+
+static inline unsigned long FrameTimes_average(const FrameTimes* frameTimes) {
+    return frameTimes->count ? frameTimes->total / frameTimes->count : 0;
+}
+
+/* Most recent frame time, 'age' 0 is the last frame added */
+static inline unsigned long FrameTimes_recent(const FrameTimes* frameTimes, int age) {
+    int i = frameTimes->next - 1 - age;
+    while (i < 0) {
+        i += frameTimes->capacity;
+    }
+    return frameTimes->times[i];
+}
+
+static int FrameTimes_compare(const void* a, const void* b) {
+    unsigned long va = *(const unsigned long*) a;
+    unsigned long vb = *(const unsigned long*) b;
+    return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+/* Sorts the history, call FrameTimes_percentile() as often as needed afterwards */
+static void FrameTimes_sort(FrameTimes* frameTimes) {
+    for (int i = 0; i < frameTimes->count; i++) {
+        frameTimes->sorted[i] = frameTimes->times[i];
+    }
+    qsort(frameTimes->sorted, frameTimes->count, sizeof(unsigned long), FrameTimes_compare);
+}
+
+/* 'percent' 0 - 100, nearest rank.  Needs a FrameTimes_sort() first. */
+static unsigned long FrameTimes_percentile(const FrameTimes* frameTimes, int percent) {
+    if (!frameTimes->count) {
+        return 0;
+    }
+    int rank = (percent * frameTimes->count + 99) / 100;
+    if (rank < 1) {
+        rank = 1;
+    }
+    return frameTimes->sorted[rank - 1];
+}
+
+#endif
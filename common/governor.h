@@ -0,0 +1,89 @@
+#ifndef AOS_COMMON_GOVERNOR_H
+#define AOS_COMMON_GOVERNOR_H
+
+#include <stdio.h>
+
+#include "platform.h"
+#include "frametime.h"
+
+/*
+ * Adaptive quality: holds the frame time under a budget by stepping a workload level up and down.
+ *
+ * Level maxLevel is everything on, 0 the least the demo is willing to draw; what each level means (how many
+ * particles, dirty rectangles instead of full clears, HUD or not...) is up to the demo.  Governor_update()
+ * looks at the average of the last GOVERNOR_WINDOW frame times once per frame, so FrameTimes should hold the
+ * time spent working on each frame, not the time spent waiting for the display.
+ *
+ * Over budget steps down at once.  Stepping up needs the average to be comfortably under budget
+ * (GOVERNOR_HEADROOM percent) for a while, and that while doubles every time a step up had to be taken back,
+ * so a machine that sits right on the edge of two levels settles on the lower one instead of flickering
+ * between them.  After any change the next decision waits for a full window of frames at the new level.
+ */
+
+#define GOVERNOR_WINDOW 16
+#define GOVERNOR_HEADROOM 75
+#define GOVERNOR_UP_DELAY 50
+#define GOVERNOR_MAX_UP_DELAY 1600
+
+typedef struct sGovernor {
+    unsigned long budget;       /* microseconds per frame */
+    int level;
+    int maxLevel;
+    int sinceChange;            /* frames at the current level */
+    int upDelay;                /* frames under budget before stepping up */
+    int lastStep;               /* +1 / -1 / 0 */
+    unsigned long stepsUp;
+    unsigned long stepsDown;
+} Governor;
+
+/* Starts at full quality, a slow machine finds its level within a few windows */
+static void Governor_init(Governor* governor, unsigned long budget, int maxLevel) {
+    governor->budget = budget;
+    governor->level = maxLevel;
+    governor->maxLevel = maxLevel;
+    governor->sinceChange = 0;
+    governor->upDelay = GOVERNOR_UP_DELAY;
+    governor->lastStep = 0;
+    governor->stepsUp = 0;
+    governor->stepsDown = 0;
+}
+
+/* Call once per frame after adding its time to 'frameTimes', returns the level for the next frame */
+static int Governor_update(Governor* governor, const FrameTimes* frameTimes) {
+    governor->sinceChange++;
+    if (governor->sinceChange < GOVERNOR_WINDOW || frameTimes->count < GOVERNOR_WINDOW) {
+        return governor->level;
+    }
+
+    unsigned long total = 0;
+    for (int age = 0; age < GOVERNOR_WINDOW; age++) {
+        total += FrameTimes_recent(frameTimes, age);
+    }
+    unsigned long average = total / GOVERNOR_WINDOW;
+
+    if (average > governor->budget && governor->level > 0) {
+        /* Taking back a step up, be slower to try it again */
+        if (governor->lastStep > 0 && governor->upDelay < GOVERNOR_MAX_UP_DELAY) {
+            governor->upDelay *= 2;
+        }
+        governor->level--;
+        governor->stepsDown++;
+        governor->lastStep = -1;
+        governor->sinceChange = 0;
+    } else if (average < governor->budget * GOVERNOR_HEADROOM / 100 && governor->level < governor->maxLevel &&
+               governor->sinceChange >= governor->upDelay) {
+        governor->level++;
+        governor->stepsUp++;
+        governor->lastStep = 1;
+        governor->sinceChange = 0;
+    }
+
+    return governor->level;
+}
+
+static void Governor_print(const Governor* governor) {
+    printf("governor: level %d of %d, budget %lu us, %lu steps down, %lu steps up\n", governor->level,
+           governor->maxLevel, governor->budget, governor->stepsDown, governor->stepsUp);
+}
+
+#endif
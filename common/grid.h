@@ -0,0 +1,189 @@
+#ifndef AOS_COMMON_GRID_H
+#define AOS_COMMON_GRID_H
+
+#include "platform.h"
+#include "memory.h"
+
+/*
+ * Uniform grid over 16.16 fixed point positions for neighbour queries.
+ *
+ * SpatialGrid_build() buckets every item by cell with a counting sort: count items per cell, prefix sum the
+ * counts into start offsets, then scatter.  No linked lists or per cell allocations, and afterwards the items
+ * of a cell (and of the cells next to it on the same row) are contiguous, with copies of their positions
+ * alongside so a query only walks a few short arrays.  Rebuilding every frame is two passes over the items
+ * plus one over the cells.
+ *
+ * Pick the cell size close to the usual query radius, then a query looks at 3x3 cells.  Cells are indexed
+ * with unsigned shorts, so SpatialGrid_init() makes them bigger than asked for if there would be more than
+ * SPATIAL_GRID_MAX_CELLS of them; queries stay exact, they just check more candidates.
+ */
+
+#define SPATIAL_GRID_MAX_CELLS 65535
+
+typedef struct sSpatialGrid {
+    int cellShift;              /* cells are (1 << cellShift) pixels square */
+    int cols;
+    int rows;
+    int capacity;
+    int count;
+    unsigned short* cellStart;  /* cols * rows + 1 offsets into items */
+    unsigned short* items;      /* item indices, sorted by cell */
+    unsigned short* itemCell;   /* cell of each item, by item index */
+    long* cellX;                /* positions in cell order */
+    long* cellY;
+    unsigned long candidates;   /* items distance checked by queries since the last build */
+} SpatialGrid;
+
+static void SpatialGrid_free(SpatialGrid* grid) {
+    Mem_free(grid->cellStart);
+    Mem_free(grid->items);
+    Mem_free(grid->itemCell);
+    Mem_free(grid->cellX);
+    Mem_free(grid->cellY);
+    grid->cellStart = 0;
+    grid->items = 0;
+    grid->itemCell = 0;
+    grid->cellX = 0;
+    grid->cellY = 0;
+}
+
+/* 'width' x 'height' in pixels, up to 65535 items */
+static int SpatialGrid_init(SpatialGrid* grid, int width, int height, int cellShift, int capacity) {
+    if (cellShift < 0) {
+        cellShift = 0;
+    }
+    for (;;) {
+        grid->cols = (width + (1 << cellShift) - 1) >> cellShift;
+        grid->rows = (height + (1 << cellShift) - 1) >> cellShift;
+        if ((long) grid->cols * grid->rows <= SPATIAL_GRID_MAX_CELLS) {
+            break;
+        }
+        cellShift++;
+    }
+    grid->cellShift = cellShift;
+    grid->capacity = capacity;
+    grid->count = 0;
+    grid->candidates = 0;
+
+    grid->cellStart = Mem_alloc((grid->cols * grid->rows + 1) * sizeof(unsigned short), MEM_FOR_CPU, TRUE);
+    grid->items = Mem_alloc(capacity * sizeof(unsigned short), MEM_FOR_CPU, FALSE);
+    grid->itemCell = Mem_alloc(capacity * sizeof(unsigned short), MEM_FOR_CPU, FALSE);
+    grid->cellX = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+    grid->cellY = Mem_alloc(capacity * sizeof(long), MEM_FOR_CPU, FALSE);
+
+    if (!grid->cellStart || !grid->items || !grid->itemCell || !grid->cellX || !grid->cellY) {
+        SpatialGrid_free(grid);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static inline int SpatialGrid_cellOf(const SpatialGrid* grid, long x, long y) {
+    int col = (int) (x >> (16 + grid->cellShift));
+    int row = (int) (y >> (16 + grid->cellShift));
+
+    if (col < 0) {
+        col = 0;
+    } else if (col >= grid->cols) {
+        col = grid->cols - 1;
+    }
+    if (row < 0) {
+        row = 0;
+    } else if (row >= grid->rows) {
+        row = grid->rows - 1;
+    }
+    return row * grid->cols + col;
+}
+
+/* Bucket 'count' items at 16.16 positions x[] / y[] */
+static void SpatialGrid_build(SpatialGrid* grid, const long* x, const long* y, int count) {
+    int numCells = grid->cols * grid->rows;
+    unsigned short* cellStart = grid->cellStart;
+
+    if (count > grid->capacity) {
+        count = grid->capacity;
+    }
+
+    for (int c = 0; c <= numCells; c++) {
+        cellStart[c] = 0;
+    }
+
+    /* count, shifted up one so the prefix sum leaves the start of each cell */
+    for (int i = 0; i < count; i++) {
+        int cell = SpatialGrid_cellOf(grid, x[i], y[i]);
+        grid->itemCell[i] = (unsigned short) cell;
+        cellStart[cell + 1]++;
+    }
+
+    for (int c = 1; c <= numCells; c++) {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    /* scatter, using cellStart[cell] as the insert position then restore it */
+    for (int i = 0; i < count; i++) {
+        int slot = cellStart[grid->itemCell[i]]++;
+        grid->items[slot] = (unsigned short) i;
+        grid->cellX[slot] = x[i];
+        grid->cellY[slot] = y[i];
+    }
+
+    for (int c = numCells; c > 0; c--) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+
+    grid->count = count;
+    grid->candidates = 0;
+}
+
+/*
+ * Items within 'radius' pixels of the 16.16 position x, y (including an item at exactly that position).
+ * Writes up to 'maxFound' item indices to 'found' and returns how many.
+ */
+static int SpatialGrid_query(SpatialGrid* grid, long x, long y, int radius, unsigned short* found, int maxFound) {
+    int numFound = 0;
+    long radius16 = (long) radius << 16;
+    /* distances compared in 1/16 pixels, small enough to square in 32 bits once outside the box is rejected */
+    long radiusSq = (long) (radius << 4) * (radius << 4);
+
+    int col0 = (int) ((x - radius16) >> (16 + grid->cellShift));
+    int col1 = (int) ((x + radius16) >> (16 + grid->cellShift));
+    int row0 = (int) ((y - radius16) >> (16 + grid->cellShift));
+    int row1 = (int) ((y + radius16) >> (16 + grid->cellShift));
+
+    /* clamped like SpatialGrid_cellOf(), items off the edge are in the edge cells */
+    col0 = col0 < 0 ? 0 : (col0 >= grid->cols ? grid->cols - 1 : col0);
+    col1 = col1 < 0 ? 0 : (col1 >= grid->cols ? grid->cols - 1 : col1);
+    row0 = row0 < 0 ? 0 : (row0 >= grid->rows ? grid->rows - 1 : row0);
+    row1 = row1 < 0 ? 0 : (row1 >= grid->rows ? grid->rows - 1 : row1);
+
+    for (int row = row0; row <= row1; row++) {
+        /* cells on a row are adjacent in the sorted arrays, so a row is one run */
+        int start = grid->cellStart[row * grid->cols + col0];
+        int end = grid->cellStart[row * grid->cols + col1 + 1];
+
+        grid->candidates += end - start;
+
+        for (int slot = start; slot < end; slot++) {
+            long dx = grid->cellX[slot] - x;
+            long dy = grid->cellY[slot] - y;
+
+            if (dx > radius16 || dx < -radius16 || dy > radius16 || dy < -radius16) {
+                continue;
+            }
+
+            dx >>= 12;
+            dy >>= 12;
+            if (dx * dx + dy * dy <= radiusSq) {
+                found[numFound++] = grid->items[slot];
+                if (numFound == maxFound) {
+                    return numFound;
+                }
+            }
+        }
+    }
+
+    return numFound;
+}
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef AOS_COMMON_HUD_H
+#define AOS_COMMON_HUD_H
+
+#include <string.h>
+
+#include "platform.h"
+
+#ifndef AOS_HOST
+#include <graphics/gfx.h>
+#include <graphics/rastport.h>
+#include <graphics/text.h>
+#include <clib/graphics_protos.h>
+#endif
+
+/*
+ * Cached glyph text for overlays (fps counters etc.).
+ *
+ * The characters an overlay needs are rasterized once with Text() at startup and kept as 1 bit per pixel rows.
+ * Strings are then copied straight into a locked chunky buffer or into bitplanes with no graphics.library
+ * calls, so an overlay that is redrawn every frame (because the renderer writes over it) costs a few hundred
+ * byte writes.  HudText only re-formats its string when the value changes.
+ *
+ * Glyphs are at most 32 pixels wide.
+ */
+
+#define HUD_MAX_GLYPHS 64
+#define HUD_MAX_GLYPH_HEIGHT 16
+#define HUD_MAX_TEXT 32
+#define HUD_TRANSPARENT -1
+
+typedef struct sHudFont {
+    int height;
+    int baseline;
+    int numGlyphs;
+    unsigned char glyphIndex[256];     /* 0 is 'missing', drawn as blank space */
+    unsigned char glyphWidth[HUD_MAX_GLYPHS];
+    unsigned long glyphRows[HUD_MAX_GLYPHS][HUD_MAX_GLYPH_HEIGHT]; /* left most pixel is bit 31 */
+} HudFont;
+
+typedef struct sHudText {
+    short x;
+    short y;                           /* top of the text, not the baseline */
+    short fg;
+    short bg;                          /* HUD_TRANSPARENT for no background */
+    const char* suffix;
+    long value;
+    int valid;
+    int length;
+    int width;
+    char text[HUD_MAX_TEXT];
+} HudText;
+
+#ifndef AOS_HOST
+/*
+ * Rasterize 'charset' in the font set on 'fontPort' (the screen's RastPort is fine).  Uses a small scratch
+ * bitmap, only at startup.
+ */
+static int Hud_initFont(HudFont* font, struct RastPort* fontPort, const char* charset) {
+    struct TextFont* textFont = fontPort->Font;
+    int height = textFont->tf_YSize;
+    if (height > HUD_MAX_GLYPH_HEIGHT) {
+        height = HUD_MAX_GLYPH_HEIGHT;
+    }
+
+    memset(font, 0, sizeof(*font));
+    font->height = height;
+    font->baseline = textFont->tf_Baseline;
+    font->numGlyphs = 1;
+
+    struct BitMap* scratch = AllocBitMap(32, height, 1, BMF_CLEAR, NULL);
+    if (!scratch) {
+        return FALSE;
+    }
+
+    struct RastPort rastPort;
+    InitRastPort(&rastPort);
+    rastPort.BitMap = scratch;
+    SetFont(&rastPort, textFont);
+    SetDrMd(&rastPort, JAM2);
+
+    /* missing glyph, one space wide */
+    font->glyphWidth[0] = (unsigned char) TextLength(&rastPort, (CONST_STRPTR) " ", 1);
+
+    for (const char* c = charset; *c && font->numGlyphs < HUD_MAX_GLYPHS; c++) {
+        unsigned char ch = (unsigned char) *c;
+        if (font->glyphIndex[ch]) {
+            continue;
+        }
+
+        int glyph = font->numGlyphs++;
+        int width = TextLength(&rastPort, (CONST_STRPTR) c, 1);
+        if (width > 32) {
+            width = 32;
+        }
+
+        SetAPen(&rastPort, 0);
+        RectFill(&rastPort, 0, 0, 31, height - 1);
+        SetAPen(&rastPort, 1);
+        SetBPen(&rastPort, 0);
+        Move(&rastPort, 0, font->baseline);
+        Text(&rastPort, (CONST_STRPTR) c, 1);
+
+        for (int y = 0; y < height; y++) {
+            unsigned long bits = 0;
+            for (int x = 0; x < width; x++) {
+                if (ReadPixel(&rastPort, x, y)) {
+                    bits |= 0x80000000ul >> x;
+                }
+            }
+            font->glyphRows[glyph][y] = bits;
+        }
+
+        font->glyphWidth[glyph] = (unsigned char) width;
+        font->glyphIndex[ch] = (unsigned char) glyph;
+    }
+
+    WaitBlit();
+    FreeBitMap(scratch);
+    return TRUE;
+}
+#endif
+
+static void HudText_init(HudText* text, const HudFont* font, int x, int baselineY, int fg, int bg,
+                         const char* suffix) {
+    text->x = (short) x;
+    text->y = (short) (baselineY - font->baseline);
+    text->fg = (short) fg;
+    text->bg = (short) bg;
+    text->suffix = suffix;
+    text->value = 0;
+    text->valid = FALSE;
+    text->length = 0;
+    text->width = 0;
+}
+
+/* Format 'value' followed by the suffix, only when it differs from what is already formatted */
+static void HudText_setNumber(HudText* text, const HudFont* font, long value) {
+    if (text->valid && text->value == value) {
+        return;
+    }
+
+    char digits[3 * sizeof(long)];
+    int numDigits = 0;
+    unsigned long v = value < 0 ? -(unsigned long) value : (unsigned long) value;
+    do {
+        digits[numDigits++] = (char) ('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    int length = 0;
+    if (value < 0) {
+        text->text[length++] = '-';
+    }
+    while (numDigits && length < HUD_MAX_TEXT - 1) {
+        text->text[length++] = digits[--numDigits];
+    }
+    for (const char* s = text->suffix; s && *s && length < HUD_MAX_TEXT - 1; s++) {
+        text->text[length++] = *s;
+    }
+    text->text[length] = 0;
+
+    int width = 0;
+    for (int i = 0; i < length; i++) {
+        width += font->glyphWidth[font->glyphIndex[(unsigned char) text->text[i]]];
+    }
+
+    text->length = length;
+    text->width = width;
+    text->value = value;
+    text->valid = TRUE;
+}
+
+/* Copy the text into an 8 bit chunky buffer, clipped to width x height */
+static void Hud_drawChunky(const HudFont* font, const HudText* text, unsigned char* buffer, int bytesPerRow,
+                           int width, int height) {
+    int x = text->x;
+    unsigned char fg = (unsigned char) text->fg;
+    unsigned char bg = (unsigned char) text->bg;
+
+    for (int i = 0; i < text->length; i++) {
+        int glyph = font->glyphIndex[(unsigned char) text->text[i]];
+        int glyphWidth = font->glyphWidth[glyph];
+        const unsigned long* rows = font->glyphRows[glyph];
+
+        int clipWidth = glyphWidth;
+        if (x + clipWidth > width) {
+            clipWidth = width - x;
+        }
+
+        unsigned char* dst = buffer + text->y * bytesPerRow + x;
+        for (int y = 0; y < font->height; y++, dst += bytesPerRow) {
+            if (text->y + y < 0 || text->y + y >= height) {
+                continue;
+            }
+            unsigned long bits = rows[y];
+            for (int px = x < 0 ? -x : 0; px < clipWidth; px++) {
+                if (bits & (0x80000000ul >> px)) {
+                    dst[px] = fg;
+                } else if (text->bg != HUD_TRANSPARENT) {
+                    dst[px] = bg;
+                }
+            }
+        }
+
+        x += glyphWidth;
+        if (x >= width) {
+            break;
+        }
+    }
+}
+
+/*
+ * Or / clear the text into bitplanes (BitMap->Planes style, 'depth' planes of 'bytesPerRow').  Works a byte at
+ * a time so any x position is fine.
+ */
+static void Hud_drawPlanar(const HudFont* font, const HudText* text, unsigned char** planes, int depth,
+                           int bytesPerRow, int width, int height) {
+    int x = text->x;
+
+    for (int i = 0; i < text->length; i++) {
+        int glyph = font->glyphIndex[(unsigned char) text->text[i]];
+        int glyphWidth = font->glyphWidth[glyph];
+        const unsigned long* rows = font->glyphRows[glyph];
+        unsigned long cellMask = glyphWidth ? ~0ul << (32 - glyphWidth) : 0;
+
+        if (x < 0 || x + glyphWidth > width) {
+            break;
+        }
+
+        int shift = x & 7;
+        for (int y = 0; y < font->height; y++) {
+            int py = text->y + y;
+            if (py < 0 || py >= height) {
+                continue;
+            }
+
+            /* 40 bits: glyph row shifted to the pixel position inside the first byte */
+            unsigned long long bits = (unsigned long long) (rows[y] & 0xffffffffu) << (8 - shift);
+            unsigned long long cell = (unsigned long long) (cellMask & 0xffffffffu) << (8 - shift);
+            int offset = py * bytesPerRow + (x >> 3);
+
+            for (int b = 0; b < 5 && (x >> 3) + b < bytesPerRow; b++) {
+                unsigned char fgBits = (unsigned char) (bits >> (32 - b * 8));
+                unsigned char cellBits = (unsigned char) (cell >> (32 - b * 8));
+                if (!cellBits) {
+                    break;
+                }
+                for (int p = 0; p < depth; p++) {
+                    unsigned char* dst = planes[p] + offset + b;
+                    unsigned char v = *dst;
+                    if (text->bg != HUD_TRANSPARENT) {
+                        v = ((text->bg >> p) & 1) ? (v | cellBits) : (v & ~cellBits);
+                    }
+                    v = ((text->fg >> p) & 1) ? (v | fgBits) : (v & ~fgBits);
+                    *dst = v;
+                }
+            }
+        }
+
+        x += glyphWidth;
+    }
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef AOS_COMMON_IFF_H
+#define AOS_COMMON_IFF_H
+
+#include <string.h>
+
+#include "platform.h"
+#include "palette.h"
+
+#ifdef AOS_HOST
+#include <stdio.h>
+#else
+#include <dos/dos.h>
+#include <clib/dos_protos.h>
+#endif
+
+/*
+ * Streaming IFF ILBM / PBM loader.
+ *
+ * Iff_open() walks the FORM up to the BODY, picking up BMHD, CMAP and CAMG on the way and skipping anything
+ * else.  The BODY is then decoded a row at a time, ByteRun1 straight from the read buffer into the caller's
+ * memory: bitplane rows for ILBM (Iff_readPlanar() fills a whole BitMap style set of planes), chunky rows for
+ * PBM.  An ILBM can also be read as chunky pixels, its plane rows then go through a one row scratch buffer.
+ * Apart from that everything goes through a IFF_BUFFER_SIZE read buffer, so loading never needs memory for
+ * the whole image or the whole file.
+ *
+ * Images larger than the destination are clipped on the right and bottom, planes beyond the destination depth
+ * and mask planes are skipped.
+ */
+
+#define IFF_BUFFER_SIZE 2048
+#define IFF_MAX_DEPTH 8
+#define IFF_MAX_ROW_BYTES 256           /* per plane, 2048 pixels */
+
+#define IFF_ID(a, b, c, d) (((unsigned long) (a) << 24) | ((unsigned long) (b) << 16) | ((c) << 8) | (d))
+
+#define IFF_COMPRESSION_NONE 0
+#define IFF_COMPRESSION_BYTERUN1 1
+
+#define IFF_MASK_HAS_MASK 1
+
+typedef struct sIffImage {
+    int width;
+    int height;
+    int depth;                          /* planes, 8 for PBM */
+    int chunky;                         /* PBM, one byte per pixel */
+    int compression;
+    int masking;
+    int transparent;
+    int numColours;                     /* from CMAP, 0 if there was none */
+    unsigned long colours[256];         /* 0xRRGGBB */
+    unsigned long viewModes;            /* from CAMG, 0 if there was none */
+} IffImage;
+
+typedef struct sIffReader {
+#ifdef AOS_HOST
+    FILE* file;
+#else
+    BPTR file;
+#endif
+    int error;
+    int pos;
+    int end;
+    unsigned long bodySize;
+    int rowsRead;
+    unsigned char buffer[IFF_BUFFER_SIZE];
+    unsigned char scratch[IFF_MAX_DEPTH][IFF_MAX_ROW_BYTES];
+} IffReader;
+
+/* Refill the read buffer, FALSE at end of file */
+static int Iff_fill(IffReader* reader) {
+    long got;
+#ifdef AOS_HOST
+    got = (long) fread(reader->buffer, 1, IFF_BUFFER_SIZE, reader->file);
+#else
+    got = Read(reader->file, reader->buffer, IFF_BUFFER_SIZE);
+#endif
+    reader->pos = 0;
+    reader->end = got > 0 ? (int) got : 0;
+    if (got <= 0) {
+        reader->error = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static inline int Iff_byte(IffReader* reader) {
+    if (reader->pos == reader->end && !Iff_fill(reader)) {
+        return 0;
+    }
+    return reader->buffer[reader->pos++];
+}
+
+static unsigned long Iff_long(IffReader* reader) {
+    unsigned long v = (unsigned long) Iff_byte(reader) << 24;
+    v |= (unsigned long) Iff_byte(reader) << 16;
+    v |= (unsigned long) Iff_byte(reader) << 8;
+    return v | (unsigned long) Iff_byte(reader);
+}
+
+static unsigned int Iff_word(IffReader* reader) {
+    unsigned int v = (unsigned int) Iff_byte(reader) << 8;
+    return v | (unsigned int) Iff_byte(reader);
+}
+
+/* Copy 'length' bytes to 'dst', or skip them when 'dst' is NULL */
+static void Iff_bytes(IffReader* reader, unsigned char* dst, unsigned long length) {
+    while (length && !reader->error) {
+        if (reader->pos == reader->end && !Iff_fill(reader)) {
+            return;
+        }
+        unsigned long n = reader->end - reader->pos;
+        if (n > length) {
+            n = length;
+        }
+        if (dst) {
+            memcpy(dst, reader->buffer + reader->pos, n);
+            dst += n;
+        }
+        reader->pos += (int) n;
+        length -= n;
+    }
+}
+
+/* Skip the rest of the current chunk and its pad byte */
+static void Iff_skipChunk(IffReader* reader, unsigned long size) {
+    Iff_bytes(reader, NULL, size + (size & 1));
+}
+
+static void Iff_close(IffReader* reader) {
+    if (reader->file) {
+#ifdef AOS_HOST
+        fclose(reader->file);
+#else
+        Close(reader->file);
+#endif
+        reader->file = 0;
+    }
+}
+
+/* Read the header chunks, leaves 'reader' at the start of the BODY.  FALSE if it's not a usable image. */
+static int Iff_open(IffReader* reader, IffImage* image, const char* path) {
+    memset(image, 0, sizeof(*image));
+    reader->error = FALSE;
+    reader->pos = 0;
+    reader->end = 0;
+    reader->bodySize = 0;
+    reader->rowsRead = 0;
+
+#ifdef AOS_HOST
+    reader->file = fopen(path, "rb");
+#else
+    reader->file = Open((CONST_STRPTR) path, MODE_OLDFILE);
+#endif
+    if (!reader->file) {
+        return FALSE;
+    }
+
+    if (Iff_long(reader) != IFF_ID('F', 'O', 'R', 'M')) {
+        Iff_close(reader);
+        return FALSE;
+    }
+    unsigned long formLeft = Iff_long(reader);
+    unsigned long type = Iff_long(reader);
+    if (type == IFF_ID('P', 'B', 'M', ' ')) {
+        image->chunky = TRUE;
+    } else if (type != IFF_ID('I', 'L', 'B', 'M')) {
+        Iff_close(reader);
+        return FALSE;
+    }
+    formLeft -= 4;
+
+    int haveHeader = FALSE;
+    while (formLeft >= 8 && !reader->error) {
+        unsigned long id = Iff_long(reader);
+        unsigned long size = Iff_long(reader);
+        formLeft -= 8 + size + (size & 1);
+
+        if (id == IFF_ID('B', 'M', 'H', 'D') && size >= 20) {
+            image->width = (int) Iff_word(reader);
+            image->height = (int) Iff_word(reader);
+            Iff_long(reader);                       /* x, y */
+            image->depth = Iff_byte(reader);
+            image->masking = Iff_byte(reader);
+            image->compression = Iff_byte(reader);
+            Iff_byte(reader);                       /* pad */
+            image->transparent = (int) Iff_word(reader);
+            Iff_skipChunk(reader, size - 14);
+            haveHeader = TRUE;
+        } else if (id == IFF_ID('C', 'M', 'A', 'P')) {
+            unsigned long count = size / 3;
+            for (unsigned long i = 0; i < count; i++) {
+                unsigned long rgb = (unsigned long) Iff_byte(reader) << 16;
+                rgb |= (unsigned long) Iff_byte(reader) << 8;
+                rgb |= (unsigned long) Iff_byte(reader);
+                if (i < 256) {
+                    image->colours[i] = rgb;
+                }
+            }
+            image->numColours = count < 256 ? (int) count : 256;
+            Iff_skipChunk(reader, size - count * 3);
+        } else if (id == IFF_ID('C', 'A', 'M', 'G') && size >= 4) {
+            image->viewModes = Iff_long(reader);
+            Iff_skipChunk(reader, size - 4);
+        } else if (id == IFF_ID('B', 'O', 'D', 'Y')) {
+            reader->bodySize = size;
+            break;
+        } else {
+            Iff_skipChunk(reader, size);
+        }
+    }
+
+    int rowBytes = ((image->width + 15) >> 4) * 2;
+    if (reader->error || !haveHeader || !reader->bodySize || image->width <= 0 || image->height <= 0 ||
+        image->depth < 1 || image->depth > IFF_MAX_DEPTH || (image->chunky && image->depth != 8) ||
+        rowBytes > IFF_MAX_ROW_BYTES || image->compression > IFF_COMPRESSION_BYTERUN1) {
+        Iff_close(reader);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Decode 'rowBytes' bytes of BODY into 'dst' (NULL to skip them), keeping only the first 'keep'.  ByteRun1
+ * runs never cross rows in a valid file, a broken one is clipped to the row rather than overrunning it.
+ */
+static void Iff_decodeRow(IffReader* reader, const IffImage* image, unsigned char* dst, int rowBytes, int keep) {
+    if (!dst) {
+        keep = 0;
+    }
+
+    if (image->compression == IFF_COMPRESSION_NONE) {
+        Iff_bytes(reader, dst, keep);
+        Iff_bytes(reader, NULL, rowBytes - keep);
+        return;
+    }
+
+    int x = 0;
+    while (x < rowBytes && !reader->error) {
+        int n = Iff_byte(reader);
+        if (n < 128) {
+            /* n + 1 literal bytes */
+            int count = n + 1;
+            if (count > rowBytes - x) {
+                count = rowBytes - x;
+            }
+            int copy = x < keep ? (keep - x < count ? keep - x : count) : 0;
+            Iff_bytes(reader, copy ? dst + x : NULL, copy);
+            Iff_bytes(reader, NULL, n + 1 - copy);
+            x += count;
+        } else if (n > 128) {
+            /* the next byte 257 - n times */
+            int count = 257 - n;
+            int v = Iff_byte(reader);
+            if (count > rowBytes - x) {
+                count = rowBytes - x;
+            }
+            if (x < keep) {
+                memset(dst + x, v, keep - x < count ? keep - x : count);
+            }
+            x += count;
+        }
+    }
+}
+
+/*
+ * Next ILBM row into 'depth' plane rows of 'bytesPerRow' bytes each (NULL rows are skipped).  FALSE at the
+ * end of the image or on a read error.
+ */
+static int Iff_readRowPlanar(IffReader* reader, const IffImage* image, unsigned char** planeRows, int depth,
+                             int bytesPerRow) {
+    if (reader->rowsRead >= image->height || reader->error || image->chunky) {
+        return FALSE;
+    }
+
+    int rowBytes = ((image->width + 15) >> 4) * 2;
+    int keep = bytesPerRow < rowBytes ? bytesPerRow : rowBytes;
+    for (int p = 0; p < image->depth; p++) {
+        Iff_decodeRow(reader, image, p < depth ? planeRows[p] : NULL, rowBytes, keep);
+    }
+    if (image->masking == IFF_MASK_HAS_MASK) {
+        Iff_decodeRow(reader, image, NULL, rowBytes, 0);
+    }
+
+    reader->rowsRead++;
+    return !reader->error;
+}
+
+/*
+ * Next row as 'width' chunky pixels.  PBM rows decode straight into 'row', ILBM rows go through the scratch
+ * planes and are converted a byte (8 pixels) at a time.
+ */
+static int Iff_readRowChunky(IffReader* reader, const IffImage* image, unsigned char* row, int width) {
+    if (reader->rowsRead >= image->height || reader->error) {
+        return FALSE;
+    }
+
+    if (width > image->width) {
+        width = image->width;
+    }
+
+    if (image->chunky) {
+        Iff_decodeRow(reader, image, row, image->width + (image->width & 1), width);
+        reader->rowsRead++;
+        return !reader->error;
+    }
+
+    unsigned char* planeRows[IFF_MAX_DEPTH];
+    for (int p = 0; p < image->depth; p++) {
+        planeRows[p] = reader->scratch[p];
+    }
+    if (!Iff_readRowPlanar(reader, image, planeRows, image->depth, IFF_MAX_ROW_BYTES)) {
+        return FALSE;
+    }
+
+    for (int x = 0; x < width; x += 8) {
+        unsigned char pixels[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (int p = 0; p < image->depth; p++) {
+            unsigned int bits = reader->scratch[p][x >> 3];
+            if (!bits) {
+                continue;
+            }
+            for (int b = 0; b < 8; b++) {
+                if (bits & (0x80 >> b)) {
+                    pixels[b] |= (unsigned char) (1 << p);
+                }
+            }
+        }
+        memcpy(row + x, pixels, width - x < 8 ? width - x : 8);
+    }
+    return TRUE;
+}
+
+/* The whole BODY into BitMap style planes, 'height' rows of 'bytesPerRow'.  Rows past the image are left alone. */
+static int Iff_readPlanar(IffReader* reader, const IffImage* image, unsigned char** planes, int depth,
+                         int bytesPerRow, int height) {
+    unsigned char* planeRows[IFF_MAX_DEPTH];
+    if (depth > IFF_MAX_DEPTH) {
+        depth = IFF_MAX_DEPTH;
+    }
+
+    for (int y = 0; y < height && y < image->height; y++) {
+        for (int p = 0; p < depth; p++) {
+            planeRows[p] = planes[p] + y * bytesPerRow;
+        }
+        if (!Iff_readRowPlanar(reader, image, planeRows, depth, bytesPerRow)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* The whole BODY into an 8 bit chunky buffer of 'width' x 'height' */
+static int Iff_readChunky(IffReader* reader, const IffImage* image, unsigned char* buffer, int bytesPerRow,
+                          int width, int height) {
+    for (int y = 0; y < height && y < image->height; y++) {
+        if (!Iff_readRowChunky(reader, image, buffer + y * bytesPerRow, width)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* CMAP colours into 'palette', as many as both have */
+static inline void Iff_setPalette(const IffImage* image, Palette* palette) {
+    for (int i = 0; i < image->numColours && i < palette->numColours; i++) {
+        Palette_set(palette, i, image->colours[i]);
+    }
+}
+
+#endif
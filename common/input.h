@@ -0,0 +1,157 @@
+#ifndef AOS_COMMON_INPUT_H
+#define AOS_COMMON_INPUT_H
+
+#include "platform.h"
+
+#ifndef AOS_HOST
+#include <intuition/intuition.h>
+#include <clib/intuition_protos.h>
+#include <clib/exec_protos.h>
+#endif
+
+/*
+ * Window input gathered once per frame.
+ *
+ * With WA_ReportMouse every mouse move is an IDCMP message, moving the mouse quickly queues dozens per frame.
+ * Input_pump() drains the UserPort, replies to everything straight away and merges all mouse moves into one
+ * position + counter.  Keys, buttons and close requests go into a single producer / single consumer ring, so
+ * the pump can also be run from a separate input task while the main loop calls Input_snapshot() once per
+ * frame to take everything that arrived since the last frame.
+ *
+ * The ring relies on aligned word / long writes being atomic (true on 68k): the producer only writes 'head'
+ * and the mouse fields, the consumer only writes 'tail'.
+ */
+
+#define INPUT_RING_SIZE 64
+
+#define INPUT_PACK_XY(x, y) ((((unsigned long) (unsigned short) (x)) << 16) | (unsigned short) (y))
+
+typedef struct sInputMsg {
+    unsigned long cls;
+    unsigned short code;
+    unsigned short qualifier;
+    short mouseX;
+    short mouseY;
+} InputMsg;
+
+typedef struct sInputState {
+    /* written by the producer only */
+    volatile unsigned short head;
+    volatile unsigned long mouseXY;         /* latest position, packed so it's written in one go */
+    volatile unsigned long mouseMoves;      /* total mouse move messages merged */
+    volatile unsigned long dropped;         /* ring was full */
+
+    /* written by the consumer only */
+    volatile unsigned short tail;
+    unsigned long lastMouseXY;
+    unsigned long lastMouseMoves;
+
+    InputMsg ring[INPUT_RING_SIZE];
+} InputState;
+
+typedef struct sInputSnapshot {
+    short mouseX;
+    short mouseY;
+    short mouseDX;
+    short mouseDY;
+    unsigned long mouseMoves;               /* mouse move messages merged into this snapshot */
+    int numEvents;
+    InputMsg events[INPUT_RING_SIZE];
+} InputSnapshot;
+
+static void Input_init(InputState* input, int mouseX, int mouseY) {
+    input->head = 0;
+    input->tail = 0;
+    input->mouseXY = INPUT_PACK_XY(mouseX, mouseY);
+    input->lastMouseXY = input->mouseXY;
+    input->mouseMoves = 0;
+    input->lastMouseMoves = 0;
+    input->dropped = 0;
+}
+
+/* Producer side.  Returns FALSE when the ring is full and the event was dropped. */
+static inline int Input_push(InputState* input, unsigned long cls, unsigned short code, unsigned short qualifier,
+                             short mouseX, short mouseY) {
+    unsigned short head = input->head;
+    unsigned short next = (head + 1) & (INPUT_RING_SIZE - 1);
+
+    if (next == input->tail) {
+        input->dropped++;
+        return FALSE;
+    }
+
+    InputMsg* msg = &input->ring[head];
+    msg->cls = cls;
+    msg->code = code;
+    msg->qualifier = qualifier;
+    msg->mouseX = mouseX;
+    msg->mouseY = mouseY;
+
+    /* Publish after the message is complete */
+    input->head = next;
+    return TRUE;
+}
+
+/* Producer side: merge a mouse move */
+static inline void Input_mouseMove(InputState* input, short mouseX, short mouseY) {
+    input->mouseXY = INPUT_PACK_XY(mouseX, mouseY);
+    input->mouseMoves++;
+}
+
+#ifndef AOS_HOST
+/*
+ * Start taking input from 'window'.  Also limits Intuition to one outstanding mouse move message, so it merges
+ * moves itself until we've replied.
+ */
+static void Input_attach(InputState* input, struct Window* window) {
+    Input_init(input, window->MouseX, window->MouseY);
+    SetMouseQueue(window, 1);
+}
+
+/* Producer side: drain the window's UserPort */
+static void Input_pump(InputState* input, struct Window* window) {
+    struct IntuiMessage* msg;
+
+    while ((msg = (struct IntuiMessage*) GetMsg(window->UserPort))) {
+        ULONG cls = msg->Class;
+        UWORD code = msg->Code;
+        UWORD qualifier = msg->Qualifier;
+        WORD mouseX = msg->MouseX;
+        WORD mouseY = msg->MouseY;
+        ReplyMsg((struct Message*) msg);
+
+        if (cls == IDCMP_MOUSEMOVE) {
+            Input_mouseMove(input, mouseX, mouseY);
+        } else {
+            Input_push(input, cls, code, qualifier, mouseX, mouseY);
+        }
+    }
+}
+#endif
+
+/* Consumer side: everything that arrived since the last snapshot */
+static void Input_snapshot(InputState* input, InputSnapshot* snapshot) {
+    unsigned long mouseXY = input->mouseXY;
+    unsigned long mouseMoves = input->mouseMoves;
+    unsigned short head = input->head;
+    unsigned short tail = input->tail;
+    int numEvents = 0;
+
+    while (tail != head) {
+        snapshot->events[numEvents++] = input->ring[tail];
+        tail = (tail + 1) & (INPUT_RING_SIZE - 1);
+    }
+    input->tail = tail;
+
+    snapshot->numEvents = numEvents;
+    snapshot->mouseX = (short) (mouseXY >> 16);
+    snapshot->mouseY = (short) (mouseXY & 0xffff);
+    snapshot->mouseDX = (short) (snapshot->mouseX - (short) (input->lastMouseXY >> 16));
+    snapshot->mouseDY = (short) (snapshot->mouseY - (short) (input->lastMouseXY & 0xffff));
+    snapshot->mouseMoves = mouseMoves - input->lastMouseMoves;
+
+    input->lastMouseXY = mouseXY;
+    input->lastMouseMoves = mouseMoves;
+}
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef AOS_COMMON_KERNELS_H
+#define AOS_COMMON_KERNELS_H
+
+#include <string.h>
+
+#include "platform.h"
+
+/*
+ * Clear / rectangle / span / pixel kernels specialized for common screen configurations.
+ *
+ * Each kernel body is a static inline function taking width, height and bytes per row as arguments.  The
+ * KERNELS_SPECIALIZE() wrappers call it with constants, so every configuration in kernelTable gets its own
+ * copy with the clipping folded, the row stride a constant and whole screen fills turned into one memset()
+ * where the rows are contiguous.  The generic wrappers call the same bodies with the target's values.
+ *
+ * Kernels_select() is called once the real size and stride are known (after the screen opens, or after the
+ * first LockBitMapTags()) and returns the exact match from the table, or the generic set for the pixel size.
+ *
+ * Pixels are 1 bit (one bitplane, bit 0 of the colour), 8 bit chunky or 16 bit chunky (the colour is the
+ * pixel value as stored).  Rectangles and spans cover [x0, x1) x [y0, y1) and are clipped to the target.
+ */
+
+typedef struct sKernelTarget {
+    unsigned char* base;                /* chunky buffer, or the bitplane for 1 bit */
+    int width;
+    int height;
+    int bytesPerRow;
+    int bitsPerPixel;
+} KernelTarget;
+
+typedef struct sKernels {
+    const char* name;
+    int width;                          /* 0 for the generic fallbacks */
+    int height;
+    int bitsPerPixel;
+    int bytesPerRow;
+    void (*clear)(const KernelTarget* target, unsigned long colour);
+    void (*rect)(const KernelTarget* target, int x0, int y0, int x1, int y1, unsigned long colour);
+    void (*span)(const KernelTarget* target, int y, int x0, int x1, unsigned long colour);
+    void (*pixel)(const KernelTarget* target, int x, int y, unsigned long colour);
+} Kernels;
+
+/* Kernel bodies --------------------------------------------------------------------------------------- */
+
+/* Clip [x0, x1) x [y0, y1) to the target, FALSE when nothing is left */
+static inline int Kernels_clip(int width, int height, int* x0, int* y0, int* x1, int* y1) {
+    if (*x0 < 0) {
+        *x0 = 0;
+    }
+    if (*y0 < 0) {
+        *y0 = 0;
+    }
+    if (*x1 > width) {
+        *x1 = width;
+    }
+    if (*y1 > height) {
+        *y1 = height;
+    }
+    return *x0 < *x1 && *y0 < *y1;
+}
+
+static inline void Kernels_rect1(unsigned char* base, int width, int height, int bytesPerRow,
+                                 int x0, int y0, int x1, int y1, unsigned long colour) {
+    if (!Kernels_clip(width, height, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    int first = x0 >> 3;
+    int last = (x1 - 1) >> 3;
+    unsigned char firstMask = (unsigned char) (0xff >> (x0 & 7));
+    unsigned char lastMask = (unsigned char) (0xff << (7 - ((x1 - 1) & 7)));
+    unsigned char fill = (colour & 1) ? 0xff : 0x00;
+    unsigned char* row = base + y0 * bytesPerRow;
+
+    if (first == last) {
+        firstMask &= lastMask;
+    } else if (x0 == 0 && x1 == width && !(width & 7) && bytesPerRow == width >> 3) {
+        memset(row, fill, (y1 - y0) * bytesPerRow);
+        return;
+    }
+
+    for (int y = y0; y < y1; y++, row += bytesPerRow) {
+        row[first] = (unsigned char) ((row[first] & ~firstMask) | (fill & firstMask));
+        if (last > first) {
+            if (last > first + 1) {
+                memset(row + first + 1, fill, last - first - 1);
+            }
+            row[last] = (unsigned char) ((row[last] & ~lastMask) | (fill & lastMask));
+        }
+    }
+}
+
+static inline void Kernels_pixel1(unsigned char* base, int width, int height, int bytesPerRow,
+                                  int x, int y, unsigned long colour) {
+    if ((unsigned int) x >= (unsigned int) width || (unsigned int) y >= (unsigned int) height) {
+        return;
+    }
+    unsigned char* p = base + y * bytesPerRow + (x >> 3);
+    if (colour & 1) {
+        *p |= (unsigned char) (0x80 >> (x & 7));
+    } else {
+        *p &= (unsigned char) ~(0x80 >> (x & 7));
+    }
+}
+
+static inline void Kernels_rect8(unsigned char* base, int width, int height, int bytesPerRow,
+                                 int x0, int y0, int x1, int y1, unsigned long colour) {
+    if (!Kernels_clip(width, height, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    unsigned char* row = base + y0 * bytesPerRow + x0;
+    if (x0 == 0 && x1 == width && bytesPerRow == width) {
+        memset(row, (int) colour, (y1 - y0) * width);
+        return;
+    }
+
+    for (int y = y0; y < y1; y++, row += bytesPerRow) {
+        memset(row, (int) colour, x1 - x0);
+    }
+}
+
+static inline void Kernels_pixel8(unsigned char* base, int width, int height, int bytesPerRow,
+                                  int x, int y, unsigned long colour) {
+    if ((unsigned int) x < (unsigned int) width && (unsigned int) y < (unsigned int) height) {
+        base[y * bytesPerRow + x] = (unsigned char) colour;
+    }
+}
+
+/* 16 bit rows are filled 32 bits (two pixels) at a time once aligned */
+static inline void Kernels_row16(unsigned short* p, int n, unsigned long colour) {
+    if (((unsigned long) p & 2) && n) {
+        *p++ = (unsigned short) colour;
+        n--;
+    }
+    unsigned int pair = (unsigned int) ((colour & 0xffff) | (colour << 16));
+    unsigned int* l = (unsigned int*) p;
+    for (; n >= 2; n -= 2) {
+        *l++ = pair;
+    }
+    if (n) {
+        *(unsigned short*) l = (unsigned short) colour;
+    }
+}
+
+static inline void Kernels_rect16(unsigned char* base, int width, int height, int bytesPerRow,
+                                  int x0, int y0, int x1, int y1, unsigned long colour) {
+    if (!Kernels_clip(width, height, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    unsigned char* row = base + y0 * bytesPerRow + x0 * 2;
+    if (x0 == 0 && x1 == width && bytesPerRow == width * 2) {
+        Kernels_row16((unsigned short*) row, (y1 - y0) * width, colour);
+        return;
+    }
+
+    for (int y = y0; y < y1; y++, row += bytesPerRow) {
+        Kernels_row16((unsigned short*) row, x1 - x0, colour);
+    }
+}
+
+static inline void Kernels_pixel16(unsigned char* base, int width, int height, int bytesPerRow,
+                                   int x, int y, unsigned long colour) {
+    if ((unsigned int) x < (unsigned int) width && (unsigned int) y < (unsigned int) height) {
+        *(unsigned short*) (base + y * bytesPerRow + x * 2) = (unsigned short) colour;
+    }
+}
+
+/* Wrappers -------------------------------------------------------------------------------------------- */
+
+/* Kernels for 'BPP' bit pixels at a fixed W x H with BPR bytes per row */
+#define KERNELS_SPECIALIZE(BPP, W, H, BPR) \
+    static void Kernels_clear##BPP##_##W##x##H(const KernelTarget* target, unsigned long colour) { \
+        Kernels_rect##BPP(target->base, W, H, BPR, 0, 0, W, H, colour); \
+    } \
+    static void Kernels_rect##BPP##_##W##x##H(const KernelTarget* target, int x0, int y0, int x1, int y1, \
+                                              unsigned long colour) { \
+        Kernels_rect##BPP(target->base, W, H, BPR, x0, y0, x1, y1, colour); \
+    } \
+    static void Kernels_span##BPP##_##W##x##H(const KernelTarget* target, int y, int x0, int x1, \
+                                              unsigned long colour) { \
+        Kernels_rect##BPP(target->base, W, H, BPR, x0, y, x1, y + 1, colour); \
+    } \
+    static void Kernels_pixel##BPP##_##W##x##H(const KernelTarget* target, int x, int y, unsigned long colour) { \
+        Kernels_pixel##BPP(target->base, W, H, BPR, x, y, colour); \
+    }
+
+#define KERNELS_ENTRY(BPP, W, H, BPR) \
+    {#W "x" #H "x" #BPP, W, H, BPP, BPR, Kernels_clear##BPP##_##W##x##H, Kernels_rect##BPP##_##W##x##H, \
+     Kernels_span##BPP##_##W##x##H, Kernels_pixel##BPP##_##W##x##H}
+
+/* Generic kernels for 'BPP' bit pixels, size and stride from the target */
+#define KERNELS_GENERIC(BPP) \
+    static void Kernels_clear##BPP##_generic(const KernelTarget* target, unsigned long colour) { \
+        Kernels_rect##BPP(target->base, target->width, target->height, target->bytesPerRow, \
+                          0, 0, target->width, target->height, colour); \
+    } \
+    static void Kernels_rect##BPP##_generic(const KernelTarget* target, int x0, int y0, int x1, int y1, \
+                                            unsigned long colour) { \
+        Kernels_rect##BPP(target->base, target->width, target->height, target->bytesPerRow, \
+                          x0, y0, x1, y1, colour); \
+    } \
+    static void Kernels_span##BPP##_generic(const KernelTarget* target, int y, int x0, int x1, \
+                                            unsigned long colour) { \
+        Kernels_rect##BPP(target->base, target->width, target->height, target->bytesPerRow, \
+                          x0, y, x1, y + 1, colour); \
+    } \
+    static void Kernels_pixel##BPP##_generic(const KernelTarget* target, int x, int y, unsigned long colour) { \
+        Kernels_pixel##BPP(target->base, target->width, target->height, target->bytesPerRow, x, y, colour); \
+    }
+
+#define KERNELS_GENERIC_ENTRY(BPP) \
+    {"generic " #BPP " bit", 0, 0, BPP, 0, Kernels_clear##BPP##_generic, Kernels_rect##BPP##_generic, \
+     Kernels_span##BPP##_generic, Kernels_pixel##BPP##_generic}
+
+KERNELS_SPECIALIZE(1, 320, 256, 40)
+KERNELS_SPECIALIZE(1, 320, 200, 40)
+KERNELS_SPECIALIZE(1, 640, 256, 80)
+KERNELS_SPECIALIZE(8, 320, 256, 320)
+KERNELS_SPECIALIZE(8, 320, 240, 320)
+KERNELS_SPECIALIZE(8, 320, 200, 320)
+KERNELS_SPECIALIZE(8, 640, 480, 640)
+KERNELS_SPECIALIZE(8, 640, 512, 640)
+KERNELS_SPECIALIZE(8, 800, 600, 800)
+KERNELS_SPECIALIZE(8, 1024, 768, 1024)
+KERNELS_SPECIALIZE(16, 320, 240, 640)
+KERNELS_SPECIALIZE(16, 640, 480, 1280)
+KERNELS_SPECIALIZE(16, 800, 600, 1600)
+KERNELS_SPECIALIZE(16, 1024, 768, 2048)
+
+KERNELS_GENERIC(1)
+KERNELS_GENERIC(8)
+KERNELS_GENERIC(16)
+
+static const Kernels kernelTable[] = {
+    KERNELS_ENTRY(1, 320, 256, 40),
+    KERNELS_ENTRY(1, 320, 200, 40),
+    KERNELS_ENTRY(1, 640, 256, 80),
+    KERNELS_ENTRY(8, 320, 256, 320),
+    KERNELS_ENTRY(8, 320, 240, 320),
+    KERNELS_ENTRY(8, 320, 200, 320),
+    KERNELS_ENTRY(8, 640, 480, 640),
+    KERNELS_ENTRY(8, 640, 512, 640),
+    KERNELS_ENTRY(8, 800, 600, 800),
+    KERNELS_ENTRY(8, 1024, 768, 1024),
+    KERNELS_ENTRY(16, 320, 240, 640),
+    KERNELS_ENTRY(16, 640, 480, 1280),
+    KERNELS_ENTRY(16, 800, 600, 1600),
+    KERNELS_ENTRY(16, 1024, 768, 2048),
+    KERNELS_GENERIC_ENTRY(1),
+    KERNELS_GENERIC_ENTRY(8),
+    KERNELS_GENERIC_ENTRY(16),
+};
+
+/* Kernels for 'target', the exact configuration when there is one.  NULL for an unsupported pixel size. */
+static const Kernels* Kernels_select(const KernelTarget* target) {
+    const Kernels* generic = NULL;
+    for (unsigned int i = 0; i < sizeof(kernelTable) / sizeof(kernelTable[0]); i++) {
+        const Kernels* kernels = &kernelTable[i];
+        if (kernels->bitsPerPixel != target->bitsPerPixel) {
+            continue;
+        }
+        if (!kernels->width) {
+            generic = kernels;
+        } else if (kernels->width == target->width && kernels->height == target->height &&
+                   kernels->bytesPerRow == target->bytesPerRow) {
+            return kernels;
+        }
+    }
+    return generic;
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef AOS_COMMON_MEMORY_H
+#define AOS_COMMON_MEMORY_H
+
+#include <stdio.h>
+
+#include "platform.h"
+
+#ifdef AOS_HOST
+#include <stdlib.h>
+#else
+#include <exec/memory.h>
+#include <clib/exec_protos.h>
+#endif
+
+/*
+ * Chip / Fast RAM placement.
+ *
+ * Chip RAM is shared with the custom chips, so the CPU has to wait for free bus slots whenever bitplane,
+ * sprite, copper or blitter DMA is busy.  On accelerated machines anything only the CPU touches (lookup tables,
+ * particle state, scratch arenas) runs a lot faster from Fast RAM.  Only data the chips read has to be in Chip.
+ *
+ *   MEM_FOR_CPU      - prefer Fast RAM, fall back to any memory (unexpanded machines only have Chip)
+ *   MEM_FOR_DISPLAY  - must be Chip RAM: sprite data, bitplanes, blitter sources
+ *
+ * Usage is tracked by where each block actually ended up, print it with Mem_printUsage().
+ *
+ * On the host there is only one kind of memory, so two pools are simulated with fixed capacities (2MB Chip and
+ * 8MB Fast by default, like an A1200 with a typical accelerator) to catch placement mistakes and over use.
+ */
+
+#define MEM_FOR_CPU 0
+#define MEM_FOR_DISPLAY 1
+
+#define MEM_POOL_CHIP 0
+#define MEM_POOL_FAST 1
+
+typedef struct sMemPoolStats {
+    unsigned long capacity; /* only used by the host simulation */
+    unsigned long used;
+    unsigned long peak;
+    unsigned long allocs;
+} MemPoolStats;
+
+/* Stored in front of every block so Mem_free() knows the size and pool */
+typedef struct sMemBlockHeader {
+    unsigned long size;
+    unsigned long pool;
+} MemBlockHeader;
+
+static MemPoolStats memPools[2] = {
+        {2 * 1024 * 1024, 0, 0, 0},
+        {8 * 1024 * 1024, 0, 0, 0},
+};
+
+static const char* memPoolNames[2] = {"chip", "fast"};
+
+/* Host only: change the simulated pool sizes, e.g. to check a 2MB Chip only machine */
+static inline void Mem_setHostPools(unsigned long chipBytes, unsigned long fastBytes) {
+    memPools[MEM_POOL_CHIP].capacity = chipBytes;
+    memPools[MEM_POOL_FAST].capacity = fastBytes;
+}
+
+#ifdef AOS_HOST
+static void* Mem_allocFromPool(unsigned long total, int pool, int clear) {
+    if (memPools[pool].used + total > memPools[pool].capacity) {
+        return 0;
+    }
+    return clear ? calloc(1, total) : malloc(total);
+}
+#endif
+
+/* Returns NULL if no memory of the required type is available */
+static void* Mem_alloc(unsigned long size, int placement, int clear) {
+    unsigned long total = size + sizeof(MemBlockHeader);
+    MemBlockHeader* header = 0;
+    int pool = MEM_POOL_CHIP;
+
+#ifdef AOS_HOST
+    if (placement == MEM_FOR_CPU && (header = Mem_allocFromPool(total, MEM_POOL_FAST, clear))) {
+        pool = MEM_POOL_FAST;
+    } else {
+        header = Mem_allocFromPool(total, MEM_POOL_CHIP, clear);
+    }
+#else
+    ULONG flags = clear ? MEMF_CLEAR : 0;
+
+    if (placement == MEM_FOR_DISPLAY) {
+        header = AllocMem(total, flags | MEMF_CHIP);
+    } else if (!(header = AllocMem(total, flags | MEMF_FAST))) {
+        header = AllocMem(total, flags | MEMF_ANY);
+    }
+
+    if (header && !(TypeOfMem(header) & MEMF_CHIP)) {
+        pool = MEM_POOL_FAST;
+    }
+#endif
+
+    if (!header) {
+        return 0;
+    }
+
+    header->size = total;
+    header->pool = pool;
+
+    MemPoolStats* stats = &memPools[pool];
+    stats->used += total;
+    stats->allocs++;
+    if (stats->used > stats->peak) {
+        stats->peak = stats->used;
+    }
+
+    return header + 1;
+}
+
+static void Mem_free(void* mem) {
+    if (mem) {
+        MemBlockHeader* header = ((MemBlockHeader*) mem) - 1;
+        memPools[header->pool].used -= header->size;
+#ifdef AOS_HOST
+        free(header);
+#else
+        FreeMem(header, header->size);
+#endif
+    }
+}
+
+static inline void Mem_printUsage() {
+    for (int i = 0; i < 2; i++) {
+        printf("%s mem: %lu bytes in use, peak %lu bytes, %lu allocs\n",
+               memPoolNames[i], memPools[i].used, memPools[i].peak, memPools[i].allocs);
+    }
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef AOS_COMMON_PALETTE_H
+#define AOS_COMMON_PALETTE_H
+
+#include "platform.h"
+#include "memory.h"
+
+#ifndef AOS_HOST
+#include <graphics/view.h>
+#include <clib/graphics_protos.h>
+#endif
+
+/*
+ * 24 bit palette with precomputed fades, uploaded with LoadRGB32() (graphics.library V39+).
+ *
+ * Colours are 0xRRGGBB.  Palette_set() and the fades only mark entries that really changed, Palette_upload()
+ * then sends just those entries in one LoadRGB32() call (runs of consecutive entries share a header in the
+ * load table).  Fades are computed once by Palette_buildFade() into a table of rows, together with the list of
+ * entries that differ between neighbouring rows, so stepping a fade costs the number of colours that change
+ * rather than the palette size.
+ *
+ * On the host Palette_upload() just records what would have been sent.
+ */
+
+typedef struct sPalette {
+    int numColours;
+    unsigned long* colours;       /* current colours */
+    unsigned char* dirtyFlag;     /* per colour, set when queued for upload */
+    unsigned short* dirty;        /* queued colour indices */
+    int numDirty;
+    unsigned long* loadTable;     /* LoadRGB32() table, worst case every colour is its own run */
+
+    /* fade table, (fadeSteps + 1) rows of numColours */
+    int fadeSteps;
+    int fadeStep;
+    unsigned long* fadeRows;
+    unsigned short* fadeDeltas;   /* per step, indices that differ from the row before */
+    unsigned long* fadeDeltaStart;
+
+    /* stats */
+    unsigned long uploads;
+    unsigned long coloursUploaded;
+} Palette;
+
+static inline int Palette_init(Palette* palette, int numColours) {
+    palette->numColours = numColours;
+    palette->numDirty = 0;
+    palette->fadeSteps = 0;
+    palette->fadeStep = 0;
+    palette->fadeRows = 0;
+    palette->fadeDeltas = 0;
+    palette->fadeDeltaStart = 0;
+    palette->uploads = 0;
+    palette->coloursUploaded = 0;
+    palette->colours = Mem_alloc(numColours * sizeof(unsigned long), MEM_FOR_CPU, TRUE);
+    palette->dirtyFlag = Mem_alloc(numColours, MEM_FOR_CPU, TRUE);
+    palette->dirty = Mem_alloc(numColours * sizeof(unsigned short), MEM_FOR_CPU, FALSE);
+    palette->loadTable = Mem_alloc((numColours * 4 + 1) * sizeof(unsigned long), MEM_FOR_CPU, FALSE);
+    if (!palette->colours || !palette->dirtyFlag || !palette->dirty || !palette->loadTable) {
+        return FALSE;
+    }
+
+    /* Whatever the display has now is unknown, the first upload sends everything */
+    for (int i = 0; i < numColours; i++) {
+        palette->dirtyFlag[i] = TRUE;
+        palette->dirty[i] = (unsigned short) i;
+    }
+    palette->numDirty = numColours;
+    return TRUE;
+}
+
+static void Palette_freeFade(Palette* palette) {
+    Mem_free(palette->fadeRows);
+    Mem_free(palette->fadeDeltas);
+    Mem_free(palette->fadeDeltaStart);
+    palette->fadeRows = 0;
+    palette->fadeDeltas = 0;
+    palette->fadeDeltaStart = 0;
+    palette->fadeSteps = 0;
+}
+
+static inline void Palette_free(Palette* palette) {
+    Palette_freeFade(palette);
+    Mem_free(palette->colours);
+    Mem_free(palette->dirtyFlag);
+    Mem_free(palette->dirty);
+    Mem_free(palette->loadTable);
+    palette->colours = 0;
+    palette->dirtyFlag = 0;
+    palette->dirty = 0;
+    palette->loadTable = 0;
+}
+
+static inline void Palette_set(Palette* palette, int index, unsigned long rgb) {
+    if (palette->colours[index] != rgb) {
+        palette->colours[index] = rgb;
+        if (!palette->dirtyFlag[index]) {
+            palette->dirtyFlag[index] = TRUE;
+            palette->dirty[palette->numDirty++] = (unsigned short) index;
+        }
+    }
+}
+
+/* Expand a 12 bit 0x0RGB colour to 0xRRGGBB */
+static inline unsigned long Palette_fromRGB4(unsigned short rgb4) {
+    unsigned long r = (rgb4 >> 8) & 0xf;
+    unsigned long g = (rgb4 >> 4) & 0xf;
+    unsigned long b = rgb4 & 0xf;
+    return (r * 0x11 << 16) | (g * 0x11 << 8) | (b * 0x11);
+}
+
+/*
+ * Precompute a cross fade from 'from' to 'to' (numColours entries each) in 'steps' steps.  Pass NULL as 'to'
+ * to fade to black.  Step 0 is 'from', step 'steps' is 'to', 'steps' has to be at least 1.
+ */
+static inline int Palette_buildFade(Palette* palette, const unsigned long* from, const unsigned long* to, int steps) {
+    int num = palette->numColours;
+
+    Palette_freeFade(palette);
+    if (steps < 1) {
+        return FALSE;
+    }
+    palette->fadeRows = Mem_alloc((steps + 1) * num * sizeof(unsigned long), MEM_FOR_CPU, FALSE);
+    palette->fadeDeltas = Mem_alloc((steps + 1) * num * sizeof(unsigned short), MEM_FOR_CPU, FALSE);
+    palette->fadeDeltaStart = Mem_alloc((steps + 2) * sizeof(unsigned long), MEM_FOR_CPU, FALSE);
+    if (!palette->fadeRows || !palette->fadeDeltas || !palette->fadeDeltaStart) {
+        Palette_freeFade(palette);
+        return FALSE;
+    }
+
+    palette->fadeSteps = steps;
+    palette->fadeStep = 0;
+
+    unsigned long* row = palette->fadeRows;
+    unsigned long numDeltas = 0;
+
+    for (int step = 0; step <= steps; step++) {
+        palette->fadeDeltaStart[step] = numDeltas;
+        for (int i = 0; i < num; i++) {
+            unsigned long a = from[i];
+            unsigned long b = to ? to[i] : 0;
+            unsigned long rgb = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                long ca = (a >> shift) & 0xff;
+                long cb = (b >> shift) & 0xff;
+                rgb |= (unsigned long) (ca + (cb - ca) * step / steps) << shift;
+            }
+            row[i] = rgb;
+            if (step && row[i] != row[i - num]) {
+                palette->fadeDeltas[numDeltas++] = (unsigned short) i;
+            }
+        }
+        row += num;
+    }
+    palette->fadeDeltaStart[steps + 1] = numDeltas;
+
+    return TRUE;
+}
+
+/*
+ * Move the fade to 'step'.  Stepping by one only touches the entries that differ between the two rows, any
+ * other jump sets the whole row.  Start a new fade with Palette_fadeTo(palette, 0).
+ */
+static inline void Palette_fadeTo(Palette* palette, int step) {
+    int num = palette->numColours;
+
+    if (step < 0) {
+        step = 0;
+    }
+    if (step > palette->fadeSteps) {
+        step = palette->fadeSteps;
+    }
+
+    const unsigned long* target = palette->fadeRows + step * num;
+
+    if (step == palette->fadeStep + 1 || step == palette->fadeStep - 1) {
+        int changedStep = step > palette->fadeStep ? step : palette->fadeStep;
+        for (unsigned long d = palette->fadeDeltaStart[changedStep]; d < palette->fadeDeltaStart[changedStep + 1]; d++) {
+            int i = palette->fadeDeltas[d];
+            Palette_set(palette, i, target[i]);
+        }
+    } else {
+        for (int i = 0; i < num; i++) {
+            Palette_set(palette, i, target[i]);
+        }
+    }
+
+    palette->fadeStep = step;
+}
+
+/* Build the load table for the queued entries, returns the number of colours in it */
+static int Palette_buildLoadTable(Palette* palette) {
+    unsigned short* dirty = palette->dirty;
+    int numDirty = palette->numDirty;
+
+    /* Usually already in order, coming from the fade delta lists */
+    for (int i = 1; i < numDirty; i++) {
+        unsigned short v = dirty[i];
+        int j = i - 1;
+        while (j >= 0 && dirty[j] > v) {
+            dirty[j + 1] = dirty[j];
+            j--;
+        }
+        dirty[j + 1] = v;
+    }
+
+    unsigned long* table = palette->loadTable;
+    unsigned long* header = 0;
+    int prev = -2;
+
+    for (int i = 0; i < numDirty; i++) {
+        int index = dirty[i];
+        unsigned long rgb = palette->colours[index];
+
+        if (index != prev + 1) {
+            header = table++;
+            *header = (unsigned long) index;
+        }
+        *header += 1ul << 16;
+
+        /* LoadRGB32() wants left justified 32 bit components */
+        *table++ = ((rgb >> 16) & 0xff) * 0x01010101ul;
+        *table++ = ((rgb >> 8) & 0xff) * 0x01010101ul;
+        *table++ = (rgb & 0xff) * 0x01010101ul;
+
+        palette->dirtyFlag[index] = FALSE;
+        prev = index;
+    }
+    *table = 0;
+
+    palette->numDirty = 0;
+    return numDirty;
+}
+
+/* Send all changed entries to the display in one call, nothing happens if nothing changed */
+#ifdef AOS_HOST
+static inline void Palette_upload(Palette* palette) {
+#else
+static inline void Palette_upload(Palette* palette, struct ViewPort* viewPort) {
+#endif
+    if (!palette->numDirty) {
+        return;
+    }
+
+    int count = Palette_buildLoadTable(palette);
+
+#ifndef AOS_HOST
+    LoadRGB32(viewPort, (ULONG*) palette->loadTable);
+#endif
+
+    palette->uploads++;
+    palette->coloursUploaded += count;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef AOS_COMMON_PLATFORM_H
+#define AOS_COMMON_PLATFORM_H
+
+/*
+ * AOS_HOST is defined when building the common/ modules with a regular host compiler (Linux etc.) instead of
+ * the m68k-amigaos / AROS toolchains.  Modules use it to swap exec / graphics calls for plain C stand-ins.
+ */
+#if !defined(__amigaos__) && !defined(__AROS__) && !defined(AMIGA)
+#define AOS_HOST 1
+#endif
+
+#ifdef AOS_HOST
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+#endif
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef AOS_COMMON_POINTS3D_H
+#define AOS_COMMON_POINTS3D_H
+
+#include <math.h>
+#include <string.h>
+
+#include "platform.h"
+#include "memory.h"
+#include "kernels.h"
+
+/*
+ * Batched 3D point transform: rotate, project, cull, depth sort and plot thousands of points a frame.
+ *
+ * Points are kept as separate x / y / z arrays of shorts (within +-POINTS3D_MAX_COORD) so the transform
+ * loop reads each one straight through.  The rotation matrix is built once per frame from the same 256 step
+ * 16.16 fsin / fcos tables the insect demos use, and stored as 2.14 shorts, so every product in the loop is
+ * a 16 x 16 bit multiply (one muls.w on a 68000) and the sums stay within 32 bits.
+ *
+ * The camera looks down +z from 'cameraZ' in front of the origin.  Rotated points outside [near, far) are
+ * dropped, the rest are projected with a reciprocal table instead of a divide: reciprocal[z] is
+ * (focal << reciprocalShift) / z, the shift picked so that even reciprocal[near] fits a short.
+ *
+ * Visible points go to output arrays with their depth bucket (POINTS3D_BUCKETS of them between near and
+ * far).  Points3D_sort() orders them back to front with a counting sort on the bucket, and Points3D_draw()
+ * plots them through the pixel kernel of a common/kernels.h set with a colour per bucket, so near points
+ * are drawn over far ones and can be brighter.
+ */
+
+#define POINTS3D_ANGLES 256
+#define POINTS3D_MAX_COORD 8191
+#define POINTS3D_MAX_POINTS 65535
+#define POINTS3D_BUCKETS 256
+
+typedef struct sPoints3D {
+    int count;
+    int capacity;
+    short* x;
+    short* y;
+    short* z;
+
+    /* projected points of the last transform, 'order' after Points3D_sort() */
+    int numVisible;
+    short* screenX;
+    short* screenY;
+    unsigned char* bucket;
+    unsigned short* order;
+    int sorted;
+
+    int width;
+    int height;
+    int centreX;
+    int centreY;
+    int focal;                          /* pixels across for a unit at distance 1 */
+    int near;
+    int far;
+    int cameraZ;
+    int bucketShift;
+
+    short matrix[9];                    /* 2.14, row major */
+    long fsin[POINTS3D_ANGLES];         /* 16.16 */
+    long fcos[POINTS3D_ANGLES];
+    short* reciprocal;                  /* indexed by rotated z, 0 .. far - 1 */
+    int reciprocalShift;
+    unsigned char colours[POINTS3D_BUCKETS];
+    unsigned short bucketCounts[POINTS3D_BUCKETS];
+
+    /* stats */
+    unsigned long transformed;
+    unsigned long drawn;
+} Points3D;
+
+static void Points3D_free(Points3D* points) {
+    Mem_free(points->x);
+    Mem_free(points->y);
+    Mem_free(points->z);
+    Mem_free(points->screenX);
+    Mem_free(points->screenY);
+    Mem_free(points->bucket);
+    Mem_free(points->order);
+    Mem_free(points->reciprocal);
+    points->x = 0;
+    points->y = 0;
+    points->z = 0;
+    points->screenX = 0;
+    points->screenY = 0;
+    points->bucket = 0;
+    points->order = 0;
+    points->reciprocal = 0;
+}
+
+/*
+ * Rotation by 'ax' about x, then 'ay' about y, then 'az' about z, angles in 256ths of a turn.  Built in
+ * 2.14 from the 16.16 tables, the intermediate products fit in 32 bits.
+ */
+static void Points3D_setRotation(Points3D* points, int ax, int ay, int az) {
+    long sx = points->fsin[ax & (POINTS3D_ANGLES - 1)] >> 2;
+    long cx = points->fcos[ax & (POINTS3D_ANGLES - 1)] >> 2;
+    long sy = points->fsin[ay & (POINTS3D_ANGLES - 1)] >> 2;
+    long cy = points->fcos[ay & (POINTS3D_ANGLES - 1)] >> 2;
+    long sz = points->fsin[az & (POINTS3D_ANGLES - 1)] >> 2;
+    long cz = points->fcos[az & (POINTS3D_ANGLES - 1)] >> 2;
+    long sxsy = (sx * sy) >> 14;
+    long cxsy = (cx * sy) >> 14;
+    short* m = points->matrix;
+
+    m[0] = (short) ((cy * cz) >> 14);
+    m[1] = (short) (((sxsy * cz) >> 14) - ((cx * sz) >> 14));
+    m[2] = (short) (((cxsy * cz) >> 14) + ((sx * sz) >> 14));
+    m[3] = (short) ((cy * sz) >> 14);
+    m[4] = (short) (((sxsy * sz) >> 14) + ((cx * cz) >> 14));
+    m[5] = (short) (((cxsy * sz) >> 14) - ((sx * cz) >> 14));
+    m[6] = (short) -sy;
+    m[7] = (short) ((sx * cy) >> 14);
+    m[8] = (short) ((cx * cy) >> 14);
+}
+
+/* Room for 'capacity' points projected onto a 'width' x 'height' screen, z between 'near' and 'far' */
+static int Points3D_init(Points3D* points, int capacity, int width, int height, int focal, int near, int far) {
+    if (capacity > POINTS3D_MAX_POINTS) {
+        capacity = POINTS3D_MAX_POINTS;
+    }
+    if (near < 1) {
+        near = 1;
+    }
+
+    points->count = 0;
+    points->capacity = capacity;
+    points->numVisible = 0;
+    points->sorted = FALSE;
+    points->width = width;
+    points->height = height;
+    points->centreX = width / 2;
+    points->centreY = height / 2;
+    points->focal = focal;
+    points->near = near;
+    points->far = far;
+    points->cameraZ = 0;
+    points->transformed = 0;
+    points->drawn = 0;
+
+    points->x = Mem_alloc(capacity * sizeof(short), MEM_FOR_CPU, FALSE);
+    points->y = Mem_alloc(capacity * sizeof(short), MEM_FOR_CPU, FALSE);
+    points->z = Mem_alloc(capacity * sizeof(short), MEM_FOR_CPU, FALSE);
+    points->screenX = Mem_alloc(capacity * sizeof(short), MEM_FOR_CPU, FALSE);
+    points->screenY = Mem_alloc(capacity * sizeof(short), MEM_FOR_CPU, FALSE);
+    points->bucket = Mem_alloc(capacity, MEM_FOR_CPU, FALSE);
+    points->order = Mem_alloc(capacity * sizeof(unsigned short), MEM_FOR_CPU, FALSE);
+    points->reciprocal = Mem_alloc(far * sizeof(short), MEM_FOR_CPU, TRUE);
+
+    if (!points->x || !points->y || !points->z || !points->screenX || !points->screenY || !points->bucket ||
+        !points->order || !points->reciprocal) {
+        Points3D_free(points);
+        return FALSE;
+    }
+
+    for (int i = 0; i < POINTS3D_ANGLES; i++) {
+        points->fsin[i] = (long) (65536 * sin(i * M_PI * 2 / POINTS3D_ANGLES));
+        points->fcos[i] = (long) (65536 * cos(i * M_PI * 2 / POINTS3D_ANGLES));
+    }
+
+    points->reciprocalShift = 16;
+    while (points->reciprocalShift > 0 && ((long) focal << points->reciprocalShift) / near > 32767) {
+        points->reciprocalShift--;
+    }
+    for (int z = near; z < far; z++) {
+        points->reciprocal[z] = (short) (((long) focal << points->reciprocalShift) / z);
+    }
+
+    points->bucketShift = 0;
+    while (((far - near - 1) >> points->bucketShift) >= POINTS3D_BUCKETS) {
+        points->bucketShift++;
+    }
+
+    /* Pen 1 at every depth until Points3D_setShades() */
+    for (int i = 0; i < POINTS3D_BUCKETS; i++) {
+        points->colours[i] = 1;
+    }
+
+    Points3D_setRotation(points, 0, 0, 0);
+    return TRUE;
+}
+
+static inline int Points3D_add(Points3D* points, int x, int y, int z) {
+    if (points->count == points->capacity) {
+        return FALSE;
+    }
+    points->x[points->count] = (short) x;
+    points->y[points->count] = (short) y;
+    points->z[points->count] = (short) z;
+    points->count++;
+    return TRUE;
+}
+
+/* Move every point 'dz' along z, wrapping within [-range, range) - a starfield flying through a box of stars */
+static void Points3D_scroll(Points3D* points, int dz, int range) {
+    short* z = points->z;
+    for (int i = 0; i < points->count; i++) {
+        int v = z[i] + dz;
+        if (v < -range) {
+            v += range * 2;
+        } else if (v >= range) {
+            v -= range * 2;
+        }
+        z[i] = (short) v;
+    }
+}
+
+/* Rotate, project and cull every point, returns how many are on screen */
+static int Points3D_transform(Points3D* points) {
+    const short m0 = points->matrix[0], m1 = points->matrix[1], m2 = points->matrix[2];
+    const short m3 = points->matrix[3], m4 = points->matrix[4], m5 = points->matrix[5];
+    const short m6 = points->matrix[6], m7 = points->matrix[7], m8 = points->matrix[8];
+    const short* xs = points->x;
+    const short* ys = points->y;
+    const short* zs = points->z;
+    const short* reciprocal = points->reciprocal;
+    const int shift = points->reciprocalShift;
+    const int bucketShift = points->bucketShift;
+    const long near = points->near;
+    const unsigned long depth = (unsigned long) (points->far - points->near);
+    const long cameraZ = points->cameraZ;
+    const int centreX = points->centreX;
+    const int centreY = points->centreY;
+    const unsigned int width = (unsigned int) points->width;
+    const unsigned int height = (unsigned int) points->height;
+    short* screenX = points->screenX;
+    short* screenY = points->screenY;
+    unsigned char* bucket = points->bucket;
+    int n = 0;
+
+    for (int i = 0; i < points->count; i++) {
+        const short x = xs[i];
+        const short y = ys[i];
+        const short z = zs[i];
+
+        /* Depth first, most of a starfield is culled before the other two rows are needed */
+        long rz = ((m6 * x + m7 * y + m8 * z) >> 14) + cameraZ;
+        if ((unsigned long) (rz - near) >= depth) {
+            continue;
+        }
+
+        const short rx = (short) ((m0 * x + m1 * y + m2 * z) >> 14);
+        const short ry = (short) ((m3 * x + m4 * y + m5 * z) >> 14);
+        const short r = reciprocal[rz];
+        const int sx = centreX + ((rx * r) >> shift);
+        const int sy = centreY - ((ry * r) >> shift);
+        if ((unsigned int) sx >= width || (unsigned int) sy >= height) {
+            continue;
+        }
+
+        screenX[n] = (short) sx;
+        screenY[n] = (short) sy;
+        bucket[n] = (unsigned char) ((rz - near) >> bucketShift);
+        n++;
+    }
+
+    points->transformed += points->count;
+    points->numVisible = n;
+    points->sorted = FALSE;
+    return n;
+}
+
+/* Counting sort of the visible points by depth bucket, farthest first */
+static void Points3D_sort(Points3D* points) {
+    unsigned short* counts = points->bucketCounts;
+    const unsigned char* bucket = points->bucket;
+    const int n = points->numVisible;
+
+    memset(counts, 0, sizeof(points->bucketCounts));
+    for (int i = 0; i < n; i++) {
+        counts[bucket[i]]++;
+    }
+
+    /* Turn the counts into start positions, bucket POINTS3D_BUCKETS - 1 (farthest) first */
+    unsigned short start = 0;
+    for (int b = POINTS3D_BUCKETS - 1; b >= 0; b--) {
+        unsigned short count = counts[b];
+        counts[b] = start;
+        start += count;
+    }
+
+    for (int i = 0; i < n; i++) {
+        points->order[counts[bucket[i]]++] = (unsigned short) i;
+    }
+    points->sorted = TRUE;
+}
+
+/*
+ * Colour per depth: 'numColours' pens from 'colours' (brightest first) spread from near to far.  Buckets
+ * beyond 'fadeDistance' (rotated z) all get the last one.
+ */
+static void Points3D_setShades(Points3D* points, const unsigned char* colours, int numColours, int fadeDistance) {
+    int fadeBuckets = (fadeDistance - points->near) >> points->bucketShift;
+    if (fadeBuckets < 1) {
+        fadeBuckets = 1;
+    }
+    for (int b = 0; b < POINTS3D_BUCKETS; b++) {
+        int shade = b >= fadeBuckets ? numColours - 1 : b * numColours / fadeBuckets;
+        points->colours[b] = colours[shade];
+    }
+}
+
+/* Plot the visible points, back to front when they have been sorted */
+static void Points3D_draw(Points3D* points, const Kernels* kernels, const KernelTarget* target) {
+    void (*pixel)(const KernelTarget*, int, int, unsigned long) = kernels->pixel;
+    const short* screenX = points->screenX;
+    const short* screenY = points->screenY;
+    const unsigned char* bucket = points->bucket;
+    const unsigned char* colours = points->colours;
+    const int n = points->numVisible;
+
+    if (points->sorted) {
+        const unsigned short* order = points->order;
+        for (int i = 0; i < n; i++) {
+            int p = order[i];
+            pixel(target, screenX[p], screenY[p], colours[bucket[p]]);
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            pixel(target, screenX[i], screenY[i], colours[bucket[i]]);
+        }
+    }
+    points->drawn += n;
+}
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef AOS_COMMON_PROFILER_H
+#define AOS_COMMON_PROFILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "memory.h"
+
+#ifdef AOS_HOST
+#include <signal.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/time.h>
+#else
+#include <exec/execbase.h>
+#include <exec/tasks.h>
+#include <dos/dos.h>
+#include <dos/dosextens.h>
+#include <dos/dostags.h>
+#include <devices/timer.h>
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+
+extern struct ExecBase* SysBase;
+#endif
+
+/*
+ * Statistical sampling profiler for the main loop.
+ *
+ * Every 'interval' microseconds the main task's program counter is recorded into a buffer allocated up
+ * front, nothing is allocated or written while sampling.  Profiler_close() writes the samples out and
+ * tools/profmap.c adds them up per function against the program's linker map (or nm output), so the time
+ * spent in code nobody thought of putting a timer around shows up too.
+ *
+ * On the Amiga a sampler process at PROFILER_PRIORITY sleeps on timer.device.  When it wakes the main task
+ * has just been switched out, and exec keeps its PC and SR at tc_SPReg: that's the sample.  A main task
+ * that was in Wait() (WaitTOF(), WaitPort()...) is counted as waiting, a PC outside the program's first
+ * code hunk (ROM, libraries, other hunks) as outside.  Each sample costs two task switches and a timer
+ * request, so keep the interval in milliseconds on a 68000.
+ *
+ * That saved context layout (PC.l SR.w d0-d7/a0-a6 on the task's stack) is not documented.  It is what the
+ * 68k exec of Kickstart 1.2 to 3.1 (exec 33 to 40) leaves there, and is assumed for the 68k exec releases
+ * up to 47 (3.2).  Other exec versions and AROS are refused outright.  Profiler_open() also checks the
+ * layout: the main task spins in its own code for PROFILER_CHECK_SAMPLES samples, and every one of them has
+ * to read as a user mode PC inside the program's loaded hunks, otherwise the profiler doesn't start.  That
+ * also catches a context with FPU state saved in front of it.
+ *
+ * On the host ITIMER_PROF raises SIGPROF every 'interval' microseconds of CPU time and the handler takes
+ * the PC from the interrupted context.  Programs need _GNU_SOURCE for the register names in <ucontext.h>.
+ *
+ * Sample offsets are from the start of the code hunk (the executable's start on the host), the offset of
+ * an anchor function (main) is stored with them so tools/profmap can line them up with the map whatever
+ * address the code was loaded at.  Only one profiler can run at a time.
+ *
+ * The interval should not divide the frame time, or every sample lands at the same point of the frame.
+ *
+ * File format, text:
+ *
+ *   AOSP 1
+ *   interval <microseconds>
+ *   anchor <hex offset>
+ *   ticks <n> program <n> waiting <n> outside <n> unknown <n> dropped <n>
+ *   <hex offset> <samples>        - one line per distinct PC, ascending
+ */
+
+#define PROFILER_VERSION 1
+#define PROFILER_PRIORITY 40
+#define PROFILER_CHECK_SAMPLES 4
+#define PROFILER_MIN_EXEC 33
+#define PROFILER_MAX_EXEC 47
+
+#ifdef AOS_HOST
+#define PROFILER_DEFAULT_INTERVAL 997
+#else
+#define PROFILER_DEFAULT_INTERVAL 9973
+#endif
+
+typedef struct sProfiler {
+    unsigned long* samples;             /* PC offsets from codeStart */
+    unsigned long capacity;
+    unsigned long count;
+    unsigned long interval;             /* microseconds */
+    unsigned long codeStart;
+    unsigned long codeSize;
+    unsigned long anchor;               /* offset of the anchor function */
+    const char* path;
+
+    /* stats */
+    unsigned long ticks;
+    unsigned long waiting;              /* main task in Wait() (host: another thread had the CPU) */
+    unsigned long outside;
+    unsigned long unknown;              /* no usable PC */
+    unsigned long dropped;              /* buffer full */
+
+    int open;
+#ifdef AOS_HOST
+    pthread_t mainThread;
+    struct sigaction previous;
+#else
+    struct Task* mainTask;
+    BPTR segList;                       /* the program's hunks, to check the saved context layout */
+    volatile int quit;
+    volatile int running;
+    volatile int checking;              /* layout check running, see Profiler_start() */
+    int checkSamples;
+    int checkFailed;
+#endif
+} Profiler;
+
+/* The signal handler / sampler process finds its Profiler here */
+static Profiler* profilerTarget;
+
+static inline void Profiler_record(Profiler* profiler, unsigned long pc) {
+    unsigned long offset = pc - profiler->codeStart;
+    if (offset >= profiler->codeSize) {
+        profiler->outside++;
+    } else if (profiler->count == profiler->capacity) {
+        profiler->dropped++;
+    } else {
+        profiler->samples[profiler->count++] = offset;
+    }
+}
+
+#ifdef AOS_HOST
+
+extern char __executable_start;
+extern char etext;
+
+static void Profiler_onSignal(int sig, siginfo_t* info, void* context) {
+    Profiler* profiler = profilerTarget;
+    ucontext_t* uc = context;
+    unsigned long pc = 0;
+
+    profiler->ticks++;
+    if (!pthread_equal(pthread_self(), profiler->mainThread)) {
+        profiler->waiting++;
+        return;
+    }
+
+#if defined(__x86_64__) && defined(REG_RIP)
+    pc = (unsigned long) uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__) && defined(REG_EIP)
+    pc = (unsigned long) uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    pc = (unsigned long) uc->uc_mcontext.pc;
+#endif
+
+    if (pc) {
+        Profiler_record(profiler, pc);
+    } else {
+        profiler->unknown++;
+    }
+}
+
+static void Profiler_findCode(Profiler* profiler) {
+    profiler->codeStart = (unsigned long) &__executable_start;
+    profiler->codeSize = (unsigned long) (&etext - &__executable_start);
+}
+
+static int Profiler_start(Profiler* profiler) {
+    struct sigaction action;
+    struct itimerval timer;
+
+    profiler->mainThread = pthread_self();
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = Profiler_onSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &profiler->previous) != 0) {
+        return FALSE;
+    }
+
+    timer.it_interval.tv_sec = profiler->interval / 1000000;
+    timer.it_interval.tv_usec = profiler->interval % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        sigaction(SIGPROF, &profiler->previous, NULL);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void Profiler_stop(Profiler* profiler) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &profiler->previous, NULL);
+}
+
+#else
+
+/* TRUE if 'pc' is inside one of the program's hunks (segment: allocation size.l, next segment.l, hunk) */
+static int Profiler_inSegments(const Profiler* profiler, unsigned long pc) {
+    for (BPTR segList = profiler->segList; segList; segList = *(BPTR*) BADDR(segList)) {
+        ULONG* segment = BADDR(segList);
+        if (pc >= (unsigned long) (segment + 1) && pc < (unsigned long) (segment - 1) + segment[-1]) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Runs in the sampler process while the main task is switched out.  The sampler has the higher priority,
+ * so the main task can't run again (and change its saved registers) until we're back in DoIO().
+ */
+static void Profiler_sample(Profiler* profiler) {
+    struct Task* task = profiler->mainTask;
+
+    if (task->tc_State != TS_READY) {
+        if (!profiler->checking) {
+            profiler->ticks++;
+            profiler->waiting++;
+        }
+        return;
+    }
+
+    /* Saved context: PC.l SR.w d0-d7/a0-a6, a task is only ever switched out in user mode */
+    ULONG* frame = (ULONG*) task->tc_SPReg;
+    UWORD sr = *(UWORD*) (frame + 1);
+    int usable = !(sr & 0x2000) && !(frame[0] & 1);
+
+    if (profiler->checking) {
+        /* The main task is spinning in Profiler_start(), so this has to be a PC in the program */
+        if (!usable || !Profiler_inSegments(profiler, frame[0])) {
+            profiler->checkFailed = TRUE;
+        }
+        if (++profiler->checkSamples == PROFILER_CHECK_SAMPLES) {
+            profiler->checking = FALSE;
+        }
+        return;
+    }
+
+    profiler->ticks++;
+    if (!usable) {
+        profiler->unknown++;
+        return;
+    }
+    Profiler_record(profiler, frame[0]);
+}
+
+static void Profiler_sampler(void) {
+    Profiler* profiler = profilerTarget;
+    struct MsgPort* port = CreateMsgPort();
+    struct timerequest* request = port ? CreateIORequest(port, sizeof(struct timerequest)) : NULL;
+
+    if (request && OpenDevice((CONST_STRPTR) TIMERNAME, UNIT_MICROHZ, &request->tr_node, 0) != 0) {
+        DeleteIORequest(request);
+        request = NULL;
+    }
+
+    profiler->running = request != NULL;
+    Signal(profiler->mainTask, SIGBREAKF_CTRL_F);
+
+    while (request && !profiler->quit) {
+        request->tr_node.io_Command = TR_ADDREQUEST;
+        request->tr_time.tv_secs = profiler->interval / 1000000;
+        request->tr_time.tv_micro = profiler->interval % 1000000;
+        DoIO(&request->tr_node);
+        Profiler_sample(profiler);
+    }
+
+    if (request) {
+        CloseDevice(&request->tr_node);
+        DeleteIORequest(request);
+    }
+    if (port) {
+        DeleteMsgPort(port);
+    }
+
+    /* stays forbidden until this process has gone, the code belongs to the main program */
+    Forbid();
+    if (profiler->running) {
+        Signal(profiler->mainTask, SIGBREAKF_CTRL_F);
+    }
+}
+
+/* The first hunk of the program's seglist, from the CLI or (started from Workbench) the process */
+static void Profiler_findCode(Profiler* profiler) {
+    struct Process* process = (struct Process*) profiler->mainTask;
+    BPTR segList = 0;
+
+    if (process->pr_CLI) {
+        segList = ((struct CommandLineInterface*) BADDR(process->pr_CLI))->cli_Module;
+    } else if (process->pr_SegList) {
+        segList = ((BPTR*) BADDR(process->pr_SegList))[3];
+    }
+
+    profiler->segList = segList;
+    if (segList) {
+        /* Segment: allocation size.l, next segment (BPTR).l, then the hunk */
+        ULONG* segment = BADDR(segList);
+        profiler->codeStart = (unsigned long) (segment + 1);
+        profiler->codeSize = segment[-1] - 8;
+    } else {
+        /* Offsets are then absolute addresses, the anchor still lines them up */
+        profiler->codeStart = 0;
+        profiler->codeSize = ~0ul;
+    }
+}
+
+static void Profiler_stop(Profiler* profiler) {
+    profiler->quit = TRUE;
+    Wait(SIGBREAKF_CTRL_F);
+}
+
+static int Profiler_start(Profiler* profiler) {
+#ifdef __AROS__
+    printf("profiler: not supported on AROS, its saved task context is laid out differently\n");
+    return FALSE;
+#endif
+    UWORD execVersion = SysBase->LibNode.lib_Version;
+    if (execVersion < PROFILER_MIN_EXEC || execVersion > PROFILER_MAX_EXEC) {
+        printf("profiler: exec %d's saved task context isn't known, not sampling\n", execVersion);
+        return FALSE;
+    }
+    if (!profiler->segList) {
+        printf("profiler: can't find the program's hunks to check the task context, not sampling\n");
+        return FALSE;
+    }
+
+    profiler->quit = FALSE;
+    profiler->running = FALSE;
+    profiler->checking = TRUE;
+    profiler->checkSamples = 0;
+    profiler->checkFailed = FALSE;
+    SetSignal(0, SIGBREAKF_CTRL_F);
+
+    if (CreateNewProcTags(NP_Entry, (ULONG) Profiler_sampler,
+                          NP_Name, (ULONG) "profiler sampler",
+                          NP_Priority, PROFILER_PRIORITY,
+                          TAG_DONE)) {
+        Wait(SIGBREAKF_CTRL_F);
+    }
+    if (!profiler->running) {
+        return FALSE;
+    }
+
+    /* Stay busy in our own code while the sampler checks where it finds the PC */
+    while (profiler->checking) {
+    }
+
+    if (profiler->checkFailed) {
+        printf("profiler: the saved task context doesn't look like exec %d's should, not sampling\n", execVersion);
+        Profiler_stop(profiler);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+#endif
+
+/*
+ * Start sampling every 'interval' microseconds (0 for PROFILER_DEFAULT_INTERVAL) into room for 'maxSamples',
+ * Profiler_close() writes them to 'path'.  'anchor' is any function of the program, main is the obvious one.
+ */
+static int Profiler_open(Profiler* profiler, const char* path, unsigned long interval, unsigned long maxSamples,
+                         void (*anchor)()) {
+    memset(profiler, 0, sizeof(*profiler));
+
+    if (profilerTarget) {
+        return FALSE;
+    }
+
+    if (!(profiler->samples = Mem_alloc(maxSamples * sizeof(unsigned long), MEM_FOR_CPU, FALSE))) {
+        return FALSE;
+    }
+    profiler->capacity = maxSamples;
+    profiler->interval = interval ? interval : PROFILER_DEFAULT_INTERVAL;
+    profiler->path = path;
+
+#ifndef AOS_HOST
+    profiler->mainTask = FindTask(NULL);
+#endif
+    Profiler_findCode(profiler);
+    profiler->anchor = (unsigned long) anchor - profiler->codeStart;
+
+    profilerTarget = profiler;
+    if (!Profiler_start(profiler)) {
+        profilerTarget = NULL;
+        Mem_free(profiler->samples);
+        profiler->samples = NULL;
+        return FALSE;
+    }
+
+    profiler->open = TRUE;
+    return TRUE;
+}
+
+static int Profiler_compare(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*) a;
+    unsigned long y = *(const unsigned long*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* Samples sorted and run length counted, one line per distinct PC */
+static int Profiler_write(Profiler* profiler) {
+    FILE* file = fopen(profiler->path, "w");
+    if (!file) {
+        return FALSE;
+    }
+
+    fprintf(file, "AOSP %d\ninterval %lu\nanchor %lx\n", PROFILER_VERSION, profiler->interval, profiler->anchor);
+    fprintf(file, "ticks %lu program %lu waiting %lu outside %lu unknown %lu dropped %lu\n", profiler->ticks,
+            profiler->count, profiler->waiting, profiler->outside, profiler->unknown, profiler->dropped);
+
+    qsort(profiler->samples, profiler->count, sizeof(unsigned long), Profiler_compare);
+    for (unsigned long i = 0; i < profiler->count;) {
+        unsigned long run = 1;
+        while (i + run < profiler->count && profiler->samples[i + run] == profiler->samples[i]) {
+            run++;
+        }
+        fprintf(file, "%lx %lu\n", profiler->samples[i], run);
+        i += run;
+    }
+
+    int ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+static void Profiler_close(Profiler* profiler) {
+    if (!profiler->open) {
+        return;
+    }
+
+    Profiler_stop(profiler);
+    profilerTarget = NULL;
+    profiler->open = FALSE;
+
+    printf("profiler: %lu samples every %lu us, %lu in the program, %lu waiting, %lu outside, %lu dropped\n",
+           profiler->ticks, profiler->interval, profiler->count, profiler->waiting, profiler->outside,
+           profiler->dropped);
+    if (!Profiler_write(profiler)) {
+        printf("Can't write profile %s\n", profiler->path);
+    }
+
+    Mem_free(profiler->samples);
+    profiler->samples = NULL;
+}
+
+#endif
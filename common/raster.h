@@ -0,0 +1,351 @@
+#ifndef AOS_COMMON_RASTER_H
+#define AOS_COMMON_RASTER_H
+
+#include <string.h>
+
+#include "platform.h"
+
+/*
+ * Software lines and flat shaded convex polygons, written straight into memory.
+ *
+ * A RasterTarget is either an 8 bit chunky buffer (LockBitMapTags() LUT8) or a set of bitplanes
+ * (BitMap->Planes).  Polygons are scan converted into one span per row and each span is filled with
+ * memset() (chunky) or masked first / last bytes plus whole bytes per plane (planar), which is what makes them
+ * cheaper than AreaFill() for small to medium shapes: no TmpRas, no blitter setup per polygon.
+ *
+ * Everything is clipped to the target's width x height.  Spans cover [left, right), rows [top, bottom), so
+ * polygons that share an edge don't overdraw it.
+ */
+
+#define RASTER_CHUNKY 0
+#define RASTER_PLANAR 1
+
+#define RASTER_MAX_HEIGHT 1024
+#define RASTER_MAX_PLANES 8
+
+typedef struct sRasterTarget {
+    int type;
+    int width;
+    int height;
+    int bytesPerRow;
+    unsigned char* chunky;
+    unsigned char* planes[RASTER_MAX_PLANES];
+    int depth;
+    unsigned long pixels;                   /* pixels written, for benchmarks */
+    short spanLeft[RASTER_MAX_HEIGHT];      /* polygon scan conversion, per row */
+    short spanRight[RASTER_MAX_HEIGHT];
+} RasterTarget;
+
+static void Raster_initChunky(RasterTarget* target, unsigned char* buffer, int bytesPerRow, int width, int height) {
+    target->type = RASTER_CHUNKY;
+    target->chunky = buffer;
+    target->bytesPerRow = bytesPerRow;
+    target->width = width;
+    target->height = height > RASTER_MAX_HEIGHT ? RASTER_MAX_HEIGHT : height;
+    target->depth = 8;
+    target->pixels = 0;
+}
+
+static inline void Raster_initPlanar(RasterTarget* target, unsigned char** planes, int depth, int bytesPerRow,
+                                     int width, int height) {
+    target->type = RASTER_PLANAR;
+    target->chunky = 0;
+    target->depth = depth > RASTER_MAX_PLANES ? RASTER_MAX_PLANES : depth;
+    for (int p = 0; p < target->depth; p++) {
+        target->planes[p] = planes[p];
+    }
+    target->bytesPerRow = bytesPerRow;
+    target->width = width;
+    target->height = height > RASTER_MAX_HEIGHT ? RASTER_MAX_HEIGHT : height;
+    target->pixels = 0;
+}
+
+/* Already clipped span [x0, x1) on row y, x0 < x1 */
+static inline void Raster_spanUnclipped(RasterTarget* target, int y, int x0, int x1, int colour) {
+    target->pixels += x1 - x0;
+
+    if (target->type == RASTER_CHUNKY) {
+        memset(target->chunky + y * target->bytesPerRow + x0, colour, x1 - x0);
+        return;
+    }
+
+    int first = x0 >> 3;
+    int last = (x1 - 1) >> 3;
+    unsigned char firstMask = (unsigned char) (0xff >> (x0 & 7));
+    unsigned char lastMask = (unsigned char) (0xff << (7 - ((x1 - 1) & 7)));
+    int offset = y * target->bytesPerRow;
+
+    if (first == last) {
+        firstMask &= lastMask;
+    }
+
+    for (int p = 0; p < target->depth; p++) {
+        unsigned char* row = target->planes[p] + offset;
+        int set = (colour >> p) & 1;
+
+        if (set) {
+            row[first] |= firstMask;
+        } else {
+            row[first] &= (unsigned char) ~firstMask;
+        }
+
+        if (last > first) {
+            if (last > first + 1) {
+                memset(row + first + 1, set ? 0xff : 0x00, last - first - 1);
+            }
+            if (set) {
+                row[last] |= lastMask;
+            } else {
+                row[last] &= (unsigned char) ~lastMask;
+            }
+        }
+    }
+}
+
+/* Horizontal span [x0, x1) on row y, clipped */
+static void Raster_span(RasterTarget* target, int y, int x0, int x1, int colour) {
+    if (y < 0 || y >= target->height) {
+        return;
+    }
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (x1 > target->width) {
+        x1 = target->width;
+    }
+    if (x0 < x1) {
+        Raster_spanUnclipped(target, y, x0, x1, colour);
+    }
+}
+
+#define RASTER_CLIP_LEFT 1
+#define RASTER_CLIP_RIGHT 2
+#define RASTER_CLIP_TOP 4
+#define RASTER_CLIP_BOTTOM 8
+
+static inline int Raster_outCode(const RasterTarget* target, int x, int y) {
+    int code = 0;
+    if (x < 0) {
+        code |= RASTER_CLIP_LEFT;
+    } else if (x >= target->width) {
+        code |= RASTER_CLIP_RIGHT;
+    }
+    if (y < 0) {
+        code |= RASTER_CLIP_TOP;
+    } else if (y >= target->height) {
+        code |= RASTER_CLIP_BOTTOM;
+    }
+    return code;
+}
+
+/* Cohen-Sutherland, returns FALSE if the line is completely outside */
+static int Raster_clipLine(const RasterTarget* target, int* x0, int* y0, int* x1, int* y1) {
+    int code0 = Raster_outCode(target, *x0, *y0);
+    int code1 = Raster_outCode(target, *x1, *y1);
+
+    while (code0 | code1) {
+        if (code0 & code1) {
+            return FALSE;
+        }
+
+        int code = code0 ? code0 : code1;
+        long x, y;
+        long dx = *x1 - *x0;
+        long dy = *y1 - *y0;
+
+        if (code & RASTER_CLIP_TOP) {
+            y = 0;
+            x = *x0 + dx * (0 - *y0) / dy;
+        } else if (code & RASTER_CLIP_BOTTOM) {
+            y = target->height - 1;
+            x = *x0 + dx * (target->height - 1 - *y0) / dy;
+        } else if (code & RASTER_CLIP_LEFT) {
+            x = 0;
+            y = *y0 + dy * (0 - *x0) / dx;
+        } else {
+            x = target->width - 1;
+            y = *y0 + dy * (target->width - 1 - *x0) / dx;
+        }
+
+        if (code == code0) {
+            *x0 = (int) x;
+            *y0 = (int) y;
+            code0 = Raster_outCode(target, *x0, *y0);
+        } else {
+            *x1 = (int) x;
+            *y1 = (int) y;
+            code1 = Raster_outCode(target, *x1, *y1);
+        }
+    }
+    return TRUE;
+}
+
+/* Bresenham line including both end points */
+static inline void Raster_line(RasterTarget* target, int x0, int y0, int x1, int y1, int colour) {
+    if (!Raster_clipLine(target, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    int stepX = 1;
+    int stepY = target->bytesPerRow;
+    if (dx < 0) {
+        dx = -dx;
+        stepX = -1;
+    }
+    if (dy < 0) {
+        dy = -dy;
+        stepY = -stepY;
+    }
+
+    int major = dx > dy ? dx : dy;
+    int minor = dx > dy ? dy : dx;
+    int error = major >> 1;
+    target->pixels += major + 1;
+
+    if (target->type == RASTER_CHUNKY) {
+        unsigned char* p = target->chunky + y0 * target->bytesPerRow + x0;
+        int majorStep = dx > dy ? stepX : stepY;
+        int minorStep = dx > dy ? stepY : stepX;
+        for (int i = 0; i <= major; i++) {
+            *p = (unsigned char) colour;
+            p += majorStep;
+            error -= minor;
+            if (error < 0) {
+                error += major;
+                p += minorStep;
+            }
+        }
+        return;
+    }
+
+    /* planar: step a byte offset + bit mask */
+    int offset = y0 * target->bytesPerRow + (x0 >> 3);
+    unsigned char mask = (unsigned char) (0x80 >> (x0 & 7));
+    int xMajor = dx > dy;
+
+    for (int i = 0; i <= major; i++) {
+        for (int p = 0; p < target->depth; p++) {
+            if ((colour >> p) & 1) {
+                target->planes[p][offset] |= mask;
+            } else {
+                target->planes[p][offset] &= (unsigned char) ~mask;
+            }
+        }
+
+        int moveX = xMajor;
+        int moveY = !xMajor;
+        error -= minor;
+        if (error < 0) {
+            error += major;
+            moveX = moveY = 1;
+        }
+
+        if (moveX) {
+            if (stepX > 0) {
+                mask >>= 1;
+                if (!mask) {
+                    mask = 0x80;
+                    offset++;
+                }
+            } else {
+                mask <<= 1;
+                if (!mask) {
+                    mask = 0x01;
+                    offset--;
+                }
+            }
+        }
+        if (moveY) {
+            offset += stepY;
+        }
+    }
+}
+
+/* Walk one polygon edge with a 16.16 DDA, widening the spans of the rows it crosses */
+static void Raster_edge(RasterTarget* target, int x0, int y0, int x1, int y1) {
+    if (y0 == y1) {
+        return;
+    }
+    if (y0 > y1) {
+        int t = x0;
+        x0 = x1;
+        x1 = t;
+        t = y0;
+        y0 = y1;
+        y1 = t;
+    }
+
+    long step = (long) (x1 - x0) * 65536 / (y1 - y0);
+    long x = (long) x0 * 65536;
+    int y = y0;
+
+    if (y < 0) {
+        x += step * -y;
+        y = 0;
+    }
+    if (y1 > target->height) {
+        y1 = target->height;
+    }
+
+    for (; y < y1; y++, x += step) {
+        short px = (short) ((x + 0xffff) >> 16);
+        if (px < target->spanLeft[y]) {
+            target->spanLeft[y] = px;
+        }
+        if (px > target->spanRight[y]) {
+            target->spanRight[y] = px;
+        }
+    }
+}
+
+/* Flat shaded convex polygon, vertices in pixels, either winding */
+static void Raster_polygon(RasterTarget* target, const short* xs, const short* ys, int numVertices, int colour) {
+    int top = ys[0];
+    int bottom = ys[0];
+
+    for (int i = 1; i < numVertices; i++) {
+        if (ys[i] < top) {
+            top = ys[i];
+        }
+        if (ys[i] > bottom) {
+            bottom = ys[i];
+        }
+    }
+
+    if (top < 0) {
+        top = 0;
+    }
+    if (bottom > target->height) {
+        bottom = target->height;
+    }
+    if (top >= bottom) {
+        return;
+    }
+
+    for (int y = top; y < bottom; y++) {
+        target->spanLeft[y] = 32767;
+        target->spanRight[y] = -32768;
+    }
+
+    for (int i = 0, j = numVertices - 1; i < numVertices; j = i++) {
+        Raster_edge(target, xs[j], ys[j], xs[i], ys[i]);
+    }
+
+    for (int y = top; y < bottom; y++) {
+        int x0 = target->spanLeft[y];
+        int x1 = target->spanRight[y];
+        if (x0 < 0) {
+            x0 = 0;
+        }
+        if (x1 > target->width) {
+            x1 = target->width;
+        }
+        if (x0 < x1) {
+            Raster_spanUnclipped(target, y, x0, x1, colour);
+        }
+    }
+}
+
+#endif
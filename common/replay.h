@@ -0,0 +1,272 @@
+#ifndef AOS_COMMON_REPLAY_H
+#define AOS_COMMON_REPLAY_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+#include "input.h"
+#include "startup.h"
+
+#ifndef AOS_HOST
+#include <devices/timer.h>
+#include <clib/exec_protos.h>
+#endif
+
+/*
+ * Input record / replay for repeatable runs.
+ *
+ * Sits between Input_snapshot() and whatever reads the snapshot.  When recording, every frame's events and
+ * merged mouse position go to a file tagged with the frame number and milliseconds since the start.  When
+ * replaying, the snapshot is replaced by the recorded one for the same frame, so together with a fixed
+ * srand() seed a run does exactly the same work every time.  Plain stdio, so works the same on the host.
+ *
+ * Times are wall clock from Startup_now() (common/startup.h).  A program that hasn't opened timer.device gets
+ * it opened by Replay_open() and closed again by Replay_close(), the program still has to define TimerBase.
+ *
+ * File format, all multi byte values big endian, counts as unsigned LEB128 varints:
+ *
+ *   "AOSR" version(1)
+ *   records:  type(1) frameDelta(var) msDelta(var) payload
+ *     REPLAY_REC_MOUSE  x(2) y(2) moves(var)
+ *     REPLAY_REC_EVENT  class(var) code(2) qualifier(2) x(2) y(2)
+ *   REPLAY_REC_END frameDelta(var)      - marks the frame the recording stopped on
+ */
+
+#define REPLAY_OFF 0
+#define REPLAY_RECORD 1
+#define REPLAY_PLAY 2
+
+#define REPLAY_VERSION 1
+
+#define REPLAY_REC_MOUSE 1
+#define REPLAY_REC_EVENT 2
+#define REPLAY_REC_END 0xff
+
+typedef struct sReplay {
+    int mode;
+    FILE* file;
+    unsigned long frame;
+    unsigned long lastFrame;       /* frame / time of the last record written or read */
+    unsigned long lastMs;
+    unsigned long long start;       /* Startup_now() ticks */
+    unsigned long ticksPerSecond;
+    int finished;                  /* replay reached the end of the recording */
+    unsigned long records;
+
+    /* replay: next record, already read */
+    int nextType;
+    unsigned long nextFrame;
+    InputMsg nextMsg;
+    unsigned long nextMoves;
+    short mouseX;
+    short mouseY;
+
+#ifndef AOS_HOST
+    struct IORequest timer;        /* only when TimerBase wasn't set up already */
+#endif
+} Replay;
+
+static void Replay_putVar(FILE* file, unsigned long v) {
+    while (v >= 0x80) {
+        putc((int) ((v & 0x7f) | 0x80), file);
+        v >>= 7;
+    }
+    putc((int) v, file);
+}
+
+static unsigned long Replay_getVar(FILE* file) {
+    unsigned long v = 0;
+    int shift = 0;
+    int c;
+    while ((c = getc(file)) != EOF) {
+        v |= (unsigned long) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    return v;
+}
+
+static void Replay_put16(FILE* file, unsigned short v) {
+    putc(v >> 8, file);
+    putc(v & 0xff, file);
+}
+
+static unsigned short Replay_get16(FILE* file) {
+    int hi = getc(file);
+    int lo = getc(file);
+    return (unsigned short) (((hi & 0xff) << 8) | (lo & 0xff));
+}
+
+static unsigned long Replay_ms(Replay* replay) {
+    unsigned long ticksPerSecond;
+    return (unsigned long) ((Startup_now(&ticksPerSecond) - replay->start) * 1000 / replay->ticksPerSecond);
+}
+
+static void Replay_readNext(Replay* replay) {
+    int type = getc(replay->file);
+
+    if (type == EOF || type == REPLAY_REC_END) {
+        replay->nextType = REPLAY_REC_END;
+        replay->nextFrame = replay->lastFrame + (type == EOF ? 0 : Replay_getVar(replay->file));
+        return;
+    }
+
+    replay->nextType = type;
+    replay->nextFrame = replay->lastFrame + Replay_getVar(replay->file);
+    replay->lastFrame = replay->nextFrame;
+    replay->lastMs += Replay_getVar(replay->file);
+
+    InputMsg* msg = &replay->nextMsg;
+    if (type == REPLAY_REC_MOUSE) {
+        msg->mouseX = (short) Replay_get16(replay->file);
+        msg->mouseY = (short) Replay_get16(replay->file);
+        replay->nextMoves = Replay_getVar(replay->file);
+    } else {
+        msg->cls = Replay_getVar(replay->file);
+        msg->code = Replay_get16(replay->file);
+        msg->qualifier = Replay_get16(replay->file);
+        msg->mouseX = (short) Replay_get16(replay->file);
+        msg->mouseY = (short) Replay_get16(replay->file);
+    }
+}
+
+static int Replay_open(Replay* replay, int mode, const char* path) {
+    memset(replay, 0, sizeof(*replay));
+
+    if (mode == REPLAY_OFF) {
+        return TRUE;
+    }
+
+#ifndef AOS_HOST
+    if (!TimerBase) {
+        if (OpenDevice((CONST_STRPTR) "timer.device", UNIT_MICROHZ, &replay->timer, 0) != 0) {
+            replay->timer.io_Device = NULL;
+            printf("Can't open timer.device for the replay clock\n");
+            return FALSE;
+        }
+        TimerBase = replay->timer.io_Device;
+    }
+#endif
+
+    if (!(replay->file = fopen(path, mode == REPLAY_RECORD ? "wb" : "rb"))) {
+        printf("Can't open replay file %s\n", path);
+        return FALSE;
+    }
+
+    if (mode == REPLAY_RECORD) {
+        fwrite("AOSR", 1, 4, replay->file);
+        putc(REPLAY_VERSION, replay->file);
+    } else {
+        char magic[4];
+        if (fread(magic, 1, 4, replay->file) != 4 || memcmp(magic, "AOSR", 4) != 0 ||
+            getc(replay->file) != REPLAY_VERSION) {
+            printf("Not a replay file: %s\n", path);
+            fclose(replay->file);
+            replay->file = 0;
+            return FALSE;
+        }
+        Replay_readNext(replay);
+    }
+
+    replay->mode = mode;
+    replay->start = Startup_now(&replay->ticksPerSecond);
+    return TRUE;
+}
+
+/* Handles '-record <file>' and '-replay <file>' */
+static int Replay_openFromArgs(Replay* replay, int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-record") == 0) {
+            return Replay_open(replay, REPLAY_RECORD, argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-replay") == 0) {
+            return Replay_open(replay, REPLAY_PLAY, argv[i + 1]);
+        }
+    }
+    return Replay_open(replay, REPLAY_OFF, 0);
+}
+
+static void Replay_writeHeader(Replay* replay, int type) {
+    unsigned long ms = Replay_ms(replay);
+    putc(type, replay->file);
+    Replay_putVar(replay->file, replay->frame - replay->lastFrame);
+    Replay_putVar(replay->file, ms - replay->lastMs);
+    replay->lastFrame = replay->frame;
+    replay->lastMs = ms;
+    replay->records++;
+}
+
+/* Call once per frame, right after Input_snapshot() */
+static void Replay_process(Replay* replay, InputSnapshot* snapshot) {
+    if (replay->mode == REPLAY_RECORD) {
+        if (snapshot->mouseMoves) {
+            Replay_writeHeader(replay, REPLAY_REC_MOUSE);
+            Replay_put16(replay->file, (unsigned short) snapshot->mouseX);
+            Replay_put16(replay->file, (unsigned short) snapshot->mouseY);
+            Replay_putVar(replay->file, snapshot->mouseMoves);
+        }
+
+        for (int i = 0; i < snapshot->numEvents; i++) {
+            InputMsg* msg = &snapshot->events[i];
+            Replay_writeHeader(replay, REPLAY_REC_EVENT);
+            Replay_putVar(replay->file, msg->cls);
+            Replay_put16(replay->file, msg->code);
+            Replay_put16(replay->file, msg->qualifier);
+            Replay_put16(replay->file, (unsigned short) msg->mouseX);
+            Replay_put16(replay->file, (unsigned short) msg->mouseY);
+        }
+    } else if (replay->mode == REPLAY_PLAY) {
+        short prevX = replay->mouseX;
+        short prevY = replay->mouseY;
+
+        snapshot->numEvents = 0;
+        snapshot->mouseMoves = 0;
+
+        while (replay->nextType != REPLAY_REC_END && replay->nextFrame == replay->frame) {
+            if (replay->nextType == REPLAY_REC_MOUSE) {
+                replay->mouseX = replay->nextMsg.mouseX;
+                replay->mouseY = replay->nextMsg.mouseY;
+                snapshot->mouseMoves += replay->nextMoves;
+            } else if (snapshot->numEvents < INPUT_RING_SIZE) {
+                snapshot->events[snapshot->numEvents++] = replay->nextMsg;
+            }
+            replay->records++;
+            Replay_readNext(replay);
+        }
+
+        snapshot->mouseX = replay->mouseX;
+        snapshot->mouseY = replay->mouseY;
+        snapshot->mouseDX = (short) (replay->mouseX - prevX);
+        snapshot->mouseDY = (short) (replay->mouseY - prevY);
+        replay->finished = replay->nextType == REPLAY_REC_END && replay->frame + 1 >= replay->nextFrame;
+    }
+
+    replay->frame++;
+}
+
+static void Replay_close(Replay* replay) {
+    if (replay->file) {
+        if (replay->mode == REPLAY_RECORD) {
+            putc(REPLAY_REC_END, replay->file);
+            Replay_putVar(replay->file, replay->frame - replay->lastFrame);
+            printf("recorded %lu input records over %lu frames\n", replay->records, replay->frame);
+        } else {
+            printf("replayed %lu input records over %lu frames\n", replay->records, replay->frame);
+        }
+        fclose(replay->file);
+        replay->file = 0;
+    }
+#ifndef AOS_HOST
+    if (replay->timer.io_Device) {
+        CloseDevice(&replay->timer);
+        replay->timer.io_Device = NULL;
+        TimerBase = NULL;
+    }
+#endif
+    replay->mode = REPLAY_OFF;
+}
+
+#endif
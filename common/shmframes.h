@@ -0,0 +1,217 @@
+#ifndef AOS_COMMON_SHMFRAMES_H
+#define AOS_COMMON_SHMFRAMES_H
+
+#include "platform.h"
+
+#ifdef AOS_HOST
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Live frames in POSIX shared memory, host only.
+ *
+ * A ring of 8 bit chunky framebuffers behind a small header, mapped by the producer and by any number of
+ * viewers (tools/shmview.c).  The producer draws straight into the slot ShmFrames_begin() returns and
+ * ShmFrames_publish() makes it the latest, so there is no copy on either side and the producer never waits
+ * or even knows whether anyone is watching.
+ *
+ * Each slot has a sequence number that is odd while the producer is writing it.  A viewer reads 'latest',
+ * notes that slot's sequence, reads the pixels, and keeps them only if the sequence is still the same even
+ * number afterwards (the producer has to go round the whole ring to come back to a slot, so with a few slots
+ * that rarely happens).
+ */
+
+#define SHMFRAMES_MAGIC 0x414f5346      /* "AOSF" */
+#define SHMFRAMES_VERSION 1
+#define SHMFRAMES_MAX_SLOTS 8
+
+typedef struct sShmFramesSlot {
+    volatile uint32_t seq;
+    uint32_t frame;
+} ShmFramesSlot;
+
+/* Shared layout, fixed size types only */
+typedef struct sShmFramesHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerRow;
+    uint32_t numSlots;
+    uint32_t slotOffset;                /* from the start of the mapping */
+    uint32_t slotSize;
+    volatile uint32_t latest;           /* newest complete slot */
+    volatile uint32_t frame;            /* frames published */
+    volatile uint32_t paletteSeq;       /* odd while the palette is being changed */
+    uint32_t palette[256];              /* 0xRRGGBB */
+    ShmFramesSlot slots[SHMFRAMES_MAX_SLOTS];
+} ShmFramesHeader;
+
+typedef struct sShmFrames {
+    char name[64];
+    int fd;
+    int owner;
+    size_t size;
+    ShmFramesHeader* header;
+    unsigned char* base;
+    uint32_t writing;                   /* slot being drawn by the producer */
+} ShmFrames;
+
+static inline void ShmFrames_store(volatile uint32_t* p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t ShmFrames_load(volatile uint32_t* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline unsigned char* ShmFrames_slot(const ShmFrames* shm, uint32_t slot) {
+    return shm->base + shm->header->slotOffset + slot * shm->header->slotSize;
+}
+
+/* Producer: create (or replace) shared memory 'name' (e.g. "/aos-frames") */
+static inline int ShmFrames_create(ShmFrames* shm, const char* name, int width, int height, int numSlots) {
+    memset(shm, 0, sizeof(*shm));
+    if (numSlots < 2) {
+        numSlots = 2;
+    } else if (numSlots > SHMFRAMES_MAX_SLOTS) {
+        numSlots = SHMFRAMES_MAX_SLOTS;
+    }
+
+    uint32_t bytesPerRow = (width + 15) & ~15;
+    uint32_t slotOffset = (sizeof(ShmFramesHeader) + 4095) & ~4095;
+    uint32_t slotSize = (bytesPerRow * height + 4095) & ~4095;
+
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->size = slotOffset + (size_t) slotSize * numSlots;
+    shm->fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (shm->fd < 0) {
+        return FALSE;
+    }
+
+    if (ftruncate(shm->fd, shm->size) != 0 ||
+        (shm->base = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0)) == MAP_FAILED) {
+        close(shm->fd);
+        shm_unlink(name);
+        shm->base = 0;
+        return FALSE;
+    }
+
+    shm->owner = TRUE;
+    shm->header = (ShmFramesHeader*) shm->base;
+    shm->header->version = SHMFRAMES_VERSION;
+    shm->header->width = width;
+    shm->header->height = height;
+    shm->header->bytesPerRow = bytesPerRow;
+    shm->header->numSlots = numSlots;
+    shm->header->slotOffset = slotOffset;
+    shm->header->slotSize = slotSize;
+    shm->header->latest = 0;
+    shm->header->frame = 0;
+    ShmFrames_store(&shm->header->magic, SHMFRAMES_MAGIC);
+    return TRUE;
+}
+
+/* Viewer: map an existing one read only */
+static inline int ShmFrames_attach(ShmFrames* shm, const char* name) {
+    struct stat st;
+
+    memset(shm, 0, sizeof(*shm));
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    shm->fd = shm_open(name, O_RDONLY, 0);
+    if (shm->fd < 0) {
+        return FALSE;
+    }
+
+    if (fstat(shm->fd, &st) != 0 || (size_t) st.st_size < sizeof(ShmFramesHeader) ||
+        (shm->base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, shm->fd, 0)) == MAP_FAILED) {
+        close(shm->fd);
+        shm->base = 0;
+        return FALSE;
+    }
+
+    shm->size = st.st_size;
+    shm->header = (ShmFramesHeader*) shm->base;
+    if (ShmFrames_load(&shm->header->magic) != SHMFRAMES_MAGIC || shm->header->version != SHMFRAMES_VERSION ||
+        shm->header->slotOffset + (size_t) shm->header->slotSize * shm->header->numSlots > shm->size) {
+        munmap(shm->base, shm->size);
+        close(shm->fd);
+        shm->base = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void ShmFrames_close(ShmFrames* shm) {
+    if (!shm->base) {
+        return;
+    }
+    munmap(shm->base, shm->size);
+    close(shm->fd);
+    if (shm->owner) {
+        shm_unlink(shm->name);
+    }
+    shm->base = 0;
+    shm->header = 0;
+}
+
+/* Producer: slot to draw the next frame into, bytesPerRow is shm->header->bytesPerRow */
+static inline unsigned char* ShmFrames_begin(ShmFrames* shm) {
+    ShmFramesHeader* header = shm->header;
+    shm->writing = (header->latest + 1) % header->numSlots;
+    ShmFramesSlot* slot = &header->slots[shm->writing];
+    ShmFrames_store(&slot->seq, slot->seq + 1);
+    /* the odd sequence has to be visible before any pixel is */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return ShmFrames_slot(shm, shm->writing);
+}
+
+/* Producer: the frame from ShmFrames_begin() is complete */
+static inline void ShmFrames_publish(ShmFrames* shm) {
+    ShmFramesHeader* header = shm->header;
+    ShmFramesSlot* slot = &header->slots[shm->writing];
+    slot->frame = header->frame + 1;
+    ShmFrames_store(&slot->seq, slot->seq + 1);
+    ShmFrames_store(&header->latest, shm->writing);
+    ShmFrames_store(&header->frame, header->frame + 1);
+}
+
+/* Producer: colours 0xRRGGBB */
+static inline void ShmFrames_setPalette(ShmFrames* shm, const unsigned long* colours, int numColours) {
+    ShmFramesHeader* header = shm->header;
+    ShmFrames_store(&header->paletteSeq, header->paletteSeq + 1);
+    for (int i = 0; i < numColours && i < 256; i++) {
+        header->palette[i] = (uint32_t) colours[i];
+    }
+    ShmFrames_store(&header->paletteSeq, header->paletteSeq + 1);
+}
+
+/*
+ * Viewer: latest complete slot, with its sequence number in *seq for ShmFrames_stillValid() once the pixels
+ * have been used.  NULL if the producer is part way through it.
+ */
+static inline const unsigned char* ShmFrames_latest(const ShmFrames* shm, uint32_t* slotIndex, uint32_t* seq) {
+    ShmFramesHeader* header = shm->header;
+    uint32_t latest = ShmFrames_load(&header->latest);
+    if (latest >= header->numSlots) {
+        return NULL;
+    }
+    *slotIndex = latest;
+    *seq = ShmFrames_load(&header->slots[latest].seq);
+    return (*seq & 1) ? NULL : ShmFrames_slot(shm, latest);
+}
+
+static inline int ShmFrames_stillValid(const ShmFrames* shm, uint32_t slotIndex, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ShmFrames_load(&shm->header->slots[slotIndex].seq) == seq;
+}
+
+#endif
+
+#endif
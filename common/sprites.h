@@ -0,0 +1,464 @@
+#ifndef AOS_COMMON_SPRITES_H
+#define AOS_COMMON_SPRITES_H
+
+#include <string.h>
+
+#include "platform.h"
+#include "memory.h"
+
+#ifndef AOS_HOST
+#include <graphics/gfx.h>
+#include <graphics/sprite.h>
+#include <graphics/view.h>
+#include <clib/graphics_protos.h>
+#endif
+
+/*
+ * Hardware sprite engine with software BOB fallback.
+ *
+ * Moving objects are mapped onto the 8 hardware sprite channels (the ones Intuition isn't using, GetSprite()
+ * hands them out).  Sprite DMA fetches new position / control words whenever a sprite image ends, so a channel
+ * can be reused further down the screen as long as the next image starts at least one line after the previous
+ * one stopped.  Each channel gets a chained sprite data list rebuilt every frame:
+ *
+ *   pos, ctl, image lines..., pos, ctl, image lines..., 0, 0
+ *
+ * Movers that don't fit on any channel (too many on the same lines) are drawn into the bitmap as BOBs with the
+ * CPU, saving the background underneath so it can be restored next frame instead of clearing the screen.
+ *
+ * All movers share one 16 pixel wide, 2 bitplane image (the usual sprite data layout: plane 0 word, plane 1 word
+ * per line).  BOBs use the combined image as a mask and draw it in a single pen.
+ *
+ * Hardware sprites colours come from the palette: channels 0/1 use colours 17-19, 2/3 21-23 and so on.
+ *
+ * On the host there are no sprites, channel assignment works the same and Sprites_composite() renders the whole
+ * lot into a chunky buffer so the result can be compared against a reference.
+ */
+
+#define SPRITE_CHANNELS 8
+#define SPRITE_IMAGE_WIDTH 16
+
+/* Colour register of sprite pixel value 1..3 on a channel */
+#define SPRITE_COLOUR(channel, value) (16 + ((channel) >> 1) * 4 + (value))
+
+typedef struct sSpriteBobSave {
+    short x;
+    short y;
+    unsigned char* saved;
+} SpriteBobSave;
+
+typedef struct sSpriteEngine {
+    const unsigned short* image;   /* 2 words per line */
+    int imageHeight;
+    int screenWidth;
+    int screenHeight;
+
+    int maxMovers;
+    int numMovers;
+    short* moverX;
+    short* moverY;
+    signed char* moverChannel;     /* -1 for BOBs */
+    short* order;                  /* mover indices sorted by y, kept between frames so sorting is cheap */
+
+    int channelOk[SPRITE_CHANNELS];
+    int channelSegments[SPRITE_CHANNELS];
+    int channelLastLine[SPRITE_CHANNELS];
+    short channelFirstX[SPRITE_CHANNELS];
+    short channelFirstY[SPRITE_CHANNELS];
+    int maxSegments;               /* per channel per frame */
+
+    int bobColour;
+    int numBobs;
+    SpriteBobSave* bobs;
+
+    /* stats for the last frame */
+    int spritesShown;
+    int bobsShown;
+
+#ifndef AOS_HOST
+    struct ViewPort* viewPort;
+    struct BitMap* bitMap;
+    struct SimpleSprite hw[SPRITE_CHANNELS];
+    unsigned short* chipData[SPRITE_CHANNELS][2];
+    int chipDataBuffer;
+    int hOffset;                   /* screen coords to sprite hardware coords */
+    int vOffset;
+    int hShift;                    /* 1 on hires screens, sprites are positioned in lores pixels */
+#endif
+} SpriteEngine;
+
+static void Sprites_encodePosCtl(unsigned short* posCtl, int hStart, int vStart, int vStop) {
+    posCtl[0] = (unsigned short) (((vStart & 0xff) << 8) | ((hStart >> 1) & 0xff));
+    posCtl[1] = (unsigned short) (((vStop & 0xff) << 8) | ((vStart >> 6) & 4) | ((vStop >> 7) & 2) | (hStart & 1));
+}
+
+#ifndef AOS_HOST
+/*
+ * Let graphics.library tell us where screen coordinates land on the sprite hardware, it knows about overscan,
+ * view offsets and hires.  MoveSprite() writes the position words into the sprite data, decode two of those.
+ */
+static void Sprites_calibrate(SpriteEngine* engine, struct SimpleSprite* sprite) {
+    int h[2], v[2];
+    for (int i = 0; i < 2; i++) {
+        MoveSprite(engine->viewPort, sprite, i * 64, i * 32);
+        unsigned short pos = sprite->posctldata[0];
+        unsigned short ctl = sprite->posctldata[1];
+        h[i] = ((pos & 0xff) << 1) | (ctl & 1);
+        v[i] = (pos >> 8) | ((ctl & 4) << 6);
+    }
+
+    if (h[1] == h[0] || v[1] == v[0]) {
+        /* Nothing written back, assume a standard lores PAL / NTSC display */
+        engine->hOffset = 0x80;
+        engine->vOffset = 0x2c;
+        engine->hShift = 0;
+        return;
+    }
+
+    engine->hShift = (h[1] - h[0]) < 64 ? 1 : 0;
+    engine->hOffset = h[0];
+    engine->vOffset = v[0];
+}
+#endif
+
+static void Sprites_free(SpriteEngine* engine) {
+#ifndef AOS_HOST
+    for (int i = 0; i < SPRITE_CHANNELS; i++) {
+        if (engine->channelOk[i]) {
+            FreeSprite(engine->hw[i].num);
+            engine->channelOk[i] = 0;
+        }
+        Mem_free(engine->chipData[i][0]);
+        Mem_free(engine->chipData[i][1]);
+        engine->chipData[i][0] = engine->chipData[i][1] = 0;
+    }
+#endif
+    if (engine->bobs) {
+        for (int i = 0; i < engine->maxMovers; i++) {
+            Mem_free(engine->bobs[i].saved);
+        }
+    }
+    Mem_free(engine->bobs);
+    Mem_free(engine->moverX);
+    Mem_free(engine->moverY);
+    Mem_free(engine->moverChannel);
+    Mem_free(engine->order);
+    engine->bobs = 0;
+    engine->moverX = engine->moverY = engine->order = 0;
+    engine->moverChannel = 0;
+}
+
+#ifdef AOS_HOST
+static int Sprites_init(SpriteEngine* engine, int screenWidth, int screenHeight,
+                        const unsigned short* image, int imageHeight, int maxMovers, int bobColour) {
+#else
+static int Sprites_init(SpriteEngine* engine, struct ViewPort* viewPort, struct BitMap* bitMap,
+                        int screenWidth, int screenHeight,
+                        const unsigned short* image, int imageHeight, int maxMovers, int bobColour) {
+#endif
+    memset(engine, 0, sizeof(*engine));
+    engine->image = image;
+    engine->imageHeight = imageHeight;
+    engine->screenWidth = screenWidth;
+    engine->screenHeight = screenHeight;
+    engine->maxMovers = maxMovers;
+    engine->bobColour = bobColour;
+    engine->maxSegments = screenHeight / (imageHeight + 1) + 1;
+
+    engine->moverX = Mem_alloc(maxMovers * sizeof(short), MEM_FOR_CPU, TRUE);
+    engine->moverY = Mem_alloc(maxMovers * sizeof(short), MEM_FOR_CPU, TRUE);
+    engine->moverChannel = Mem_alloc(maxMovers, MEM_FOR_CPU, TRUE);
+    engine->order = Mem_alloc(maxMovers * sizeof(short), MEM_FOR_CPU, TRUE);
+    engine->bobs = Mem_alloc(maxMovers * sizeof(SpriteBobSave), MEM_FOR_CPU, TRUE);
+    if (!engine->moverX || !engine->moverY || !engine->moverChannel || !engine->order || !engine->bobs) {
+        Sprites_free(engine);
+        return FALSE;
+    }
+
+    for (int i = 0; i < maxMovers; i++) {
+        engine->order[i] = i;
+    }
+
+#ifdef AOS_HOST
+    /* Channel 0 is the mouse pointer on a real machine */
+    for (int i = 1; i < SPRITE_CHANNELS; i++) {
+        engine->channelOk[i] = TRUE;
+    }
+#else
+    engine->viewPort = viewPort;
+    engine->bitMap = bitMap;
+
+    /* 3 bytes per line covers a 16 pixel image at any bit offset */
+    for (int i = 0; i < maxMovers; i++) {
+        if (!(engine->bobs[i].saved = Mem_alloc(3 * imageHeight * bitMap->Depth, MEM_FOR_CPU, FALSE))) {
+            Sprites_free(engine);
+            return FALSE;
+        }
+    }
+
+    unsigned long chainWords = engine->maxSegments * (2 + imageHeight * 2) + 2;
+    int calibrated = FALSE;
+
+    for (int i = 0; i < SPRITE_CHANNELS; i++) {
+        struct SimpleSprite* sprite = &engine->hw[i];
+        sprite->height = 0;
+        if (GetSprite(sprite, i) != i) {
+            continue;
+        }
+        engine->channelOk[i] = TRUE;
+
+        for (int j = 0; j < 2; j++) {
+            if (!(engine->chipData[i][j] = Mem_alloc(chainWords * sizeof(UWORD), MEM_FOR_DISPLAY, TRUE))) {
+                Sprites_free(engine);
+                return FALSE;
+            }
+        }
+
+        if (!calibrated) {
+            sprite->height = imageHeight;
+            ChangeSprite(viewPort, sprite, engine->chipData[i][0]);
+            Sprites_calibrate(engine, sprite);
+            sprite->height = 0;
+            calibrated = TRUE;
+        }
+        ChangeSprite(viewPort, sprite, engine->chipData[i][0]);
+    }
+#endif
+
+    return TRUE;
+}
+
+#ifndef AOS_HOST
+static void Sprites_restoreBobs(SpriteEngine* engine) {
+    struct BitMap* bitMap = engine->bitMap;
+    int height = engine->imageHeight;
+
+    /* Reverse order so overlapping BOBs unwind correctly */
+    for (int i = engine->numBobs - 1; i >= 0; i--) {
+        SpriteBobSave* bob = &engine->bobs[i];
+        unsigned char* saved = bob->saved;
+        int bytes = bitMap->BytesPerRow - (bob->x >> 3);
+        if (bytes > 3) {
+            bytes = 3;
+        }
+
+        for (int p = 0; p < bitMap->Depth; p++) {
+            unsigned char* dst = bitMap->Planes[p] + bob->y * bitMap->BytesPerRow + (bob->x >> 3);
+            for (int line = 0; line < height && bob->y + line < engine->screenHeight; line++) {
+                for (int b = 0; b < bytes; b++) {
+                    dst[b] = saved[b];
+                }
+                saved += 3;
+                dst += bitMap->BytesPerRow;
+            }
+        }
+    }
+    engine->numBobs = 0;
+}
+
+static void Sprites_drawBob(SpriteEngine* engine, int x, int y) {
+    struct BitMap* bitMap = engine->bitMap;
+    SpriteBobSave* bob = &engine->bobs[engine->numBobs++];
+    unsigned char* saved = bob->saved;
+    int bytes = bitMap->BytesPerRow - (x >> 3);
+    if (bytes > 3) {
+        bytes = 3;
+    }
+
+    bob->x = x;
+    bob->y = y;
+
+    for (int p = 0; p < bitMap->Depth; p++) {
+        int set = (engine->bobColour >> p) & 1;
+        unsigned char* dst = bitMap->Planes[p] + y * bitMap->BytesPerRow + (x >> 3);
+        const unsigned short* image = engine->image;
+
+        for (int line = 0; line < engine->imageHeight && y + line < engine->screenHeight; line++) {
+            /* image mask aligned to a 24 bit window starting at the byte containing x */
+            unsigned long mask = ((unsigned long) (image[0] | image[1]) << 8) >> (x & 7);
+            for (int b = 0; b < bytes; b++) {
+                unsigned char m = (unsigned char) (mask >> (16 - b * 8));
+                saved[b] = dst[b];
+                dst[b] = set ? (dst[b] | m) : (dst[b] & ~m);
+            }
+            saved += 3;
+            image += 2;
+            dst += bitMap->BytesPerRow;
+        }
+    }
+}
+#endif
+
+/*
+ * Move the movers to new positions.  Assigns sprite channels top to bottom, rebuilds the sprite lists and
+ * redraws the BOBs.  Call once per frame, after WaitTOF() to avoid BOB flicker on a single buffered screen.
+ */
+static void Sprites_update(SpriteEngine* engine, const short* x, const short* y, int count) {
+    short* order = engine->order;
+    int height = engine->imageHeight;
+
+    if (count > engine->maxMovers) {
+        count = engine->maxMovers;
+    }
+
+    if (count != engine->numMovers) {
+        for (int i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        engine->numMovers = count;
+    }
+
+    for (int i = 0; i < count; i++) {
+        engine->moverX[i] = x[i];
+        engine->moverY[i] = y[i];
+    }
+
+    /* Insertion sort by y, movers barely change order between frames so this is close to linear */
+    for (int i = 1; i < count; i++) {
+        short m = order[i];
+        short my = engine->moverY[m];
+        int j = i - 1;
+        while (j >= 0 && engine->moverY[order[j]] > my) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = m;
+    }
+
+#ifndef AOS_HOST
+    Sprites_restoreBobs(engine);
+
+    unsigned short* chain[SPRITE_CHANNELS];
+    int buffer = engine->chipDataBuffer;
+    for (int c = 0; c < SPRITE_CHANNELS; c++) {
+        chain[c] = engine->chipData[c][buffer];
+    }
+#endif
+
+    for (int c = 0; c < SPRITE_CHANNELS; c++) {
+        engine->channelSegments[c] = 0;
+        engine->channelLastLine[c] = -2;
+    }
+
+    engine->spritesShown = 0;
+    engine->bobsShown = 0;
+
+    for (int i = 0; i < count; i++) {
+        int m = order[i];
+        int my = engine->moverY[m];
+        int channel = -1;
+
+        /* DMA needs one free line after an image to fetch the next position */
+        for (int c = 0; c < SPRITE_CHANNELS; c++) {
+            if (engine->channelOk[c] &&
+                engine->channelLastLine[c] + 1 < my &&
+                engine->channelSegments[c] < engine->maxSegments) {
+                channel = c;
+                break;
+            }
+        }
+
+        engine->moverChannel[m] = (signed char) channel;
+
+        if (channel >= 0) {
+            if (!engine->channelSegments[channel]) {
+                engine->channelFirstX[channel] = engine->moverX[m];
+                engine->channelFirstY[channel] = (short) my;
+            }
+            engine->channelLastLine[channel] = my + height - 1;
+            engine->channelSegments[channel]++;
+            engine->spritesShown++;
+#ifndef AOS_HOST
+            unsigned short* data = chain[channel];
+            int hStart = (engine->moverX[m] >> engine->hShift) + engine->hOffset;
+            int vStart = my + engine->vOffset;
+            Sprites_encodePosCtl(data, hStart, vStart, vStart + height);
+            data += 2;
+            for (int line = 0; line < height * 2; line++) {
+                *data++ = engine->image[line];
+            }
+            chain[channel] = data;
+#endif
+        } else {
+            engine->bobsShown++;
+#ifndef AOS_HOST
+            int mx = engine->moverX[m];
+            if (mx >= 0 && my >= 0 && mx < engine->screenWidth && my < engine->screenHeight) {
+                Sprites_drawBob(engine, mx, my);
+            }
+#endif
+        }
+    }
+
+#ifndef AOS_HOST
+    for (int c = 0; c < SPRITE_CHANNELS; c++) {
+        if (!engine->channelOk[c]) {
+            continue;
+        }
+
+        unsigned short* data = engine->chipData[c][buffer];
+        struct SimpleSprite* sprite = &engine->hw[c];
+
+        chain[c][0] = 0;
+        chain[c][1] = 0;
+
+        /*
+         * ChangeSprite() rewrites the first position words from sprite->x/y/height, keep them in line with the
+         * first segment.  A zero height sprite shows nothing and falls straight through to the end words.
+         */
+        if (engine->channelSegments[c]) {
+            sprite->x = engine->channelFirstX[c];
+            sprite->y = engine->channelFirstY[c];
+            sprite->height = height;
+        } else {
+            Sprites_encodePosCtl(data, engine->hOffset, engine->vOffset, engine->vOffset);
+            data[2] = 0;
+            data[3] = 0;
+            sprite->x = 0;
+            sprite->y = 0;
+            sprite->height = 0;
+        }
+
+        ChangeSprite(engine->viewPort, sprite, engine->chipData[c][buffer]);
+    }
+
+    /* Next frame builds into the list the display isn't reading */
+    engine->chipDataBuffer = buffer ^ 1;
+#endif
+}
+
+/*
+ * Software composite of the last Sprites_update() into a chunky buffer: BOBs into the playfield first, then
+ * sprites in hardware priority order (lower channels in front).  Pixel values are colour register numbers.
+ */
+static void Sprites_composite(const SpriteEngine* engine, unsigned char* chunky, int width, int height,
+                              int bytesPerRow) {
+    for (int pass = SPRITE_CHANNELS; pass >= 0; pass--) {
+        for (int m = 0; m < engine->numMovers; m++) {
+            int channel = engine->moverChannel[m];
+            if ((pass == SPRITE_CHANNELS && channel != -1) || (pass < SPRITE_CHANNELS && channel != pass)) {
+                continue;
+            }
+
+            const unsigned short* image = engine->image;
+            for (int line = 0; line < engine->imageHeight; line++, image += 2) {
+                int py = engine->moverY[m] + line;
+                if (py < 0 || py >= height) {
+                    continue;
+                }
+
+                unsigned char* dst = chunky + py * bytesPerRow;
+                for (int bit = 0; bit < SPRITE_IMAGE_WIDTH; bit++) {
+                    int px = engine->moverX[m] + bit;
+                    int value = ((image[0] >> (15 - bit)) & 1) | (((image[1] >> (15 - bit)) & 1) << 1);
+                    if (!value || px < 0 || px >= width) {
+                        continue;
+                    }
+                    dst[px] = (unsigned char) (channel < 0 ? engine->bobColour : SPRITE_COLOUR(channel, value));
+                }
+            }
+        }
+    }
+}
+
+#endif
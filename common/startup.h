@@ -0,0 +1,94 @@
+#ifndef AOS_COMMON_STARTUP_H
+#define AOS_COMMON_STARTUP_H
+
+#include <stdio.h>
+
+#include "platform.h"
+
+#ifdef AOS_HOST
+#include <time.h>
+#else
+#include <devices/timer.h>
+#include <clib/timer_protos.h>
+
+extern struct Device* TimerBase;
+#endif
+
+/*
+ * Startup phase timing.
+ *
+ * Startup_mark() stamps the end of a phase with the EClock (clock_gettime() on the host), Startup_firstFrame()
+ * closes the profile once the first frame has been drawn.  Startup_print() lists every phase with its own
+ * duration and the total time to the first frame, so the slow parts of getting a picture on screen show up
+ * next to the per frame numbers.
+ *
+ * On the Amiga timer.device has to be open (TimerBase set) before Startup_begin(), so open it first.
+ */
+
+#define STARTUP_MAX_PHASES 24
+
+typedef struct sStartupProfile {
+    int numPhases;
+    int firstFrameDone;
+    unsigned long ticksPerSecond;
+    unsigned long long start;
+    const char* names[STARTUP_MAX_PHASES];
+    unsigned long long ends[STARTUP_MAX_PHASES];
+} StartupProfile;
+
+static inline unsigned long long Startup_now(unsigned long* ticksPerSecond) {
+#ifdef AOS_HOST
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    *ticksPerSecond = 1000000000ul;
+    return (unsigned long long) now.tv_sec * 1000000000ull + now.tv_nsec;
+#else
+    struct EClockVal clock;
+    *ticksPerSecond = ReadEClock(&clock);
+    return (((unsigned long long) clock.ev_hi) << 32u) | clock.ev_lo;
+#endif
+}
+
+static void Startup_begin(StartupProfile* profile) {
+    profile->numPhases = 0;
+    profile->firstFrameDone = FALSE;
+    profile->start = Startup_now(&profile->ticksPerSecond);
+}
+
+/* End of phase 'name' (a string literal, it's not copied) */
+static void Startup_mark(StartupProfile* profile, const char* name) {
+    unsigned long ticksPerSecond;
+    if (profile->firstFrameDone || profile->numPhases == STARTUP_MAX_PHASES) {
+        return;
+    }
+    profile->ends[profile->numPhases] = Startup_now(&ticksPerSecond);
+    profile->names[profile->numPhases++] = name;
+}
+
+/* Call after every frame, only the first one is recorded */
+static inline void Startup_firstFrame(StartupProfile* profile) {
+    if (!profile->firstFrameDone) {
+        Startup_mark(profile, "first frame");
+        profile->firstFrameDone = TRUE;
+    }
+}
+
+static unsigned long Startup_micros(const StartupProfile* profile, unsigned long long ticks) {
+    return (unsigned long) (ticks * 1000000 / profile->ticksPerSecond);
+}
+
+static void Startup_print(const StartupProfile* profile) {
+    unsigned long long prev = profile->start;
+
+    printf("startup:\n");
+    for (int i = 0; i < profile->numPhases; i++) {
+        printf("  %-24s %8luus\n", profile->names[i], Startup_micros(profile, profile->ends[i] - prev));
+        prev = profile->ends[i];
+    }
+
+    if (profile->firstFrameDone) {
+        printf("  time to first frame      %8luus\n", Startup_micros(profile, prev - profile->start));
+    }
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef AOS_COMMON_VBLANK_H
+#define AOS_COMMON_VBLANK_H
+
+#include <stdio.h>
+
+#include "platform.h"
+
+#ifdef AOS_HOST
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#else
+#include <exec/execbase.h>
+#include <exec/interrupts.h>
+#include <hardware/intbits.h>
+#include <clib/exec_protos.h>
+
+extern struct ExecBase* SysBase;
+#endif
+
+/*
+ * Frame pacing from a vertical blank interrupt server.
+ *
+ * WaitTOF() only ever waits for the next vertical blank, so a frame that took a little longer than one
+ * frame time waits for a whole extra one, and there's no way to tell how many were lost.  Instead a server
+ * on the VERTB interrupt chain counts vertical blanks and signals the main task while it's waiting.
+ * VBlank_nextFrame() waits until 'interval' vertical blanks after the last frame: if that one has already
+ * gone by the frame is late, the vertical blanks missed are counted and the next frame starts straight away
+ * rather than waiting for yet another one.  The waiting task runs as soon as the interrupt has signalled it,
+ * so the code after VBlank_waitFor() is the work scheduled right after the vertical blank.
+ *
+ * The count is that of the chipset display (like WaitTOF()), also on RTG screens.  On the host a thread
+ * ticking at VBLANK_HOST_RATE stands in for the interrupt.
+ */
+
+#define VBLANK_HOST_RATE 50
+
+typedef struct sVBlank {
+    volatile unsigned long count;       /* vertical blanks since VBlank_open() */
+    volatile int waiting;               /* main task is in VBlank_waitFor() */
+    unsigned long target;               /* vertical blank the last frame was paced to */
+    unsigned long frames;
+    unsigned long lateFrames;           /* frames that came after their vertical blank had passed */
+    unsigned long missed;               /* vertical blanks lost to late frames */
+    unsigned long sleeps;               /* waits that actually had to wait */
+    int open;
+#ifdef AOS_HOST
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t tick;
+    volatile int quit;
+#else
+    struct Interrupt interrupt;
+    struct Task* task;
+    BYTE signalBit;
+    ULONG signalMask;
+#endif
+} VBlank;
+
+/* Vertical blanks since VBlank_open() */
+static inline unsigned long VBlank_count(const VBlank* vblank) {
+#ifdef AOS_HOST
+    return __atomic_load_n(&vblank->count, __ATOMIC_ACQUIRE);
+#else
+    return vblank->count;
+#endif
+}
+
+#ifdef AOS_HOST
+
+static void* VBlank_thread(void* data) {
+    VBlank* vblank = data;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!__atomic_load_n(&vblank->quit, __ATOMIC_ACQUIRE)) {
+        next.tv_nsec += 1000000000l / VBLANK_HOST_RATE;
+        if (next.tv_nsec >= 1000000000l) {
+            next.tv_nsec -= 1000000000l;
+            next.tv_sec++;
+        }
+        /* An absolute wait can simply be restarted when a signal (SIGPROF, see common/profiler.h) cuts it short */
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+
+        pthread_mutex_lock(&vblank->lock);
+        __atomic_add_fetch(&vblank->count, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&vblank->tick);
+        pthread_mutex_unlock(&vblank->lock);
+    }
+    return NULL;
+}
+
+#else
+
+/*
+ * Runs in the VERTB interrupt with the VBlank in a1.  Returning 0 (Z flag set) lets the rest of the chain,
+ * graphics.library's own vertical blank work included, run after us.
+ */
+static ULONG VBlank_server(register VBlank* vblank __asm("a1")) {
+    vblank->count++;
+    if (vblank->waiting) {
+        Signal(vblank->task, vblank->signalMask);
+    }
+    return 0;
+}
+
+#endif
+
+static int VBlank_open(VBlank* vblank) {
+    vblank->count = 0;
+    vblank->waiting = FALSE;
+    vblank->target = 0;
+    vblank->frames = 0;
+    vblank->lateFrames = 0;
+    vblank->missed = 0;
+    vblank->sleeps = 0;
+    vblank->open = FALSE;
+
+#ifdef AOS_HOST
+    vblank->quit = FALSE;
+    pthread_mutex_init(&vblank->lock, NULL);
+    pthread_cond_init(&vblank->tick, NULL);
+    if (pthread_create(&vblank->thread, NULL, VBlank_thread, vblank) != 0) {
+        pthread_cond_destroy(&vblank->tick);
+        pthread_mutex_destroy(&vblank->lock);
+        return FALSE;
+    }
+#else
+    if ((vblank->signalBit = AllocSignal(-1)) == -1) {
+        return FALSE;
+    }
+    vblank->signalMask = 1ul << vblank->signalBit;
+    vblank->task = FindTask(NULL);
+
+    vblank->interrupt.is_Node.ln_Type = NT_INTERRUPT;
+    vblank->interrupt.is_Node.ln_Pri = 0;
+    vblank->interrupt.is_Node.ln_Name = "aos vblank";
+    vblank->interrupt.is_Data = vblank;
+    vblank->interrupt.is_Code = (void (*)()) VBlank_server;
+    AddIntServer(INTB_VERTB, &vblank->interrupt);
+#endif
+
+    vblank->open = TRUE;
+    return TRUE;
+}
+
+static void VBlank_close(VBlank* vblank) {
+    if (!vblank->open) {
+        return;
+    }
+
+#ifdef AOS_HOST
+    __atomic_store_n(&vblank->quit, TRUE, __ATOMIC_RELEASE);
+    pthread_join(vblank->thread, NULL);
+    pthread_cond_destroy(&vblank->tick);
+    pthread_mutex_destroy(&vblank->lock);
+#else
+    RemIntServer(INTB_VERTB, &vblank->interrupt);
+    FreeSignal(vblank->signalBit);
+#endif
+
+    vblank->open = FALSE;
+}
+
+/* Vertical blanks per second */
+static unsigned long VBlank_rate() {
+#ifdef AOS_HOST
+    return VBLANK_HOST_RATE;
+#else
+    return SysBase->VBlankFrequency;
+#endif
+}
+
+/* Wait until vertical blank number 'target' (counted from VBlank_open()) has happened, returns the count */
+static unsigned long VBlank_waitFor(VBlank* vblank, unsigned long target) {
+#ifdef AOS_HOST
+    pthread_mutex_lock(&vblank->lock);
+    if ((long) (VBlank_count(vblank) - target) < 0) {
+        vblank->sleeps++;
+        while ((long) (VBlank_count(vblank) - target) < 0) {
+            pthread_cond_wait(&vblank->tick, &vblank->lock);
+        }
+    }
+    pthread_mutex_unlock(&vblank->lock);
+#else
+    if ((long) (vblank->count - target) < 0) {
+        vblank->sleeps++;
+        vblank->waiting = TRUE;
+        /* A signal left over from an earlier wait only costs one extra time round */
+        while ((long) (vblank->count - target) < 0) {
+            Wait(vblank->signalMask);
+        }
+        vblank->waiting = FALSE;
+    }
+#endif
+    return VBlank_count(vblank);
+}
+
+/*
+ * Pace frames 'interval' vertical blanks apart (1 for every frame at the display rate).  Returns how many
+ * vertical blanks were missed because the previous frame took too long, 0 when it was on time.
+ */
+static unsigned long VBlank_nextFrame(VBlank* vblank, int interval) {
+    unsigned long target = vblank->target + interval;
+    unsigned long now = VBlank_count(vblank);
+    unsigned long missed = 0;
+
+    if ((long) (now - target) > 0) {
+        missed = now - target;
+        vblank->missed += missed;
+        vblank->lateFrames++;
+        target = now;
+    }
+
+    VBlank_waitFor(vblank, target);
+    vblank->target = target;
+    vblank->frames++;
+    return missed;
+}
+
+static void VBlank_print(const VBlank* vblank) {
+    printf("vblank pacing: %lu frames over %lu vblanks at %lu Hz, %lu late, %lu vblanks missed, %lu waits\n",
+           vblank->frames, vblank->count, VBlank_rate(), vblank->lateFrames, vblank->missed, vblank->sleeps);
+}
+
+#endif
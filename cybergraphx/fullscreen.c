@@ -18,6 +18,18 @@
 #include <cybergraphx/cybergraphics.h>
 #include <inline/cybergraphics.h>
 
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/palette.h"
+#include "../common/hud.h"
+#include "../common/frametime.h"
+#include "../common/startup.h"
+#include "../common/capture.h"
+#include "../common/counters.h"
+#include "../common/vblank.h"
+#include "../common/kernels.h"
+#include "../common/profiler.h"
+
 #define KC_ESC 0x45
 
 typedef unsigned char u8;
@@ -31,6 +43,26 @@ typedef unsigned long long u64;
  *
  * Draws moving vertical lines so you can see any screen tearing or jank.
  *
+ * The fps counter is copied into the locked buffer from glyphs rasterized once at startup (common/hud.h),
+ * rather than going through Text() every frame.
+ *
+ * How long each startup phase took and the time to the first frame are printed on exit (common/startup.h).
+ *
+ * Frames are paced by a vertical blank interrupt server rather than WaitTOF() (common/vblank.h), frames that
+ * came too late and the vertical blanks they lost are printed on exit.
+ *
+ * The bars are filled by the span kernels for the screen's size and stride (common/kernels.h), picked once
+ * the first lock has told us the real bytes per row.  The batch report shows which set each mode used.
+ *
+ * Command line:
+ *   -mode <id>         use this display mode id instead of asking with the ASL requester
+ *   -batch <frames>    benchmark every 8bit RTG mode for <frames> frames each, no requester, no vsync
+ *   -report <file>     also write the batch results to <file>
+ *   -record / -replay  see common/replay.h
+ *   -capture <file>    record what is drawn, see common/capture.h and tools/capture2ppm.c
+ *   -profile <file>    sample where the time goes, see common/profiler.h and tools/profmap.c
+ *   -profinterval <us> microseconds between profiler samples
+ *
  * Works in UAE with:
  * - 3.1 with RTG enabled
  * - AROS
@@ -46,22 +78,63 @@ struct Device* TimerBase; // exported so AOS timer func stubs can use
 static struct Screen* aosScreen;
 static struct Window* aosWindow;
 
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
 static int screenWidth = 0;
 static int screenHeight = 0;
 
+/* Kernels for the locked screen bitmap, selected again whenever its size or stride changes */
+static KernelTarget barTarget;
+static const Kernels* barKernels;
+
+/* Bar renderer state, kept between frames */
+typedef struct sBarState {
+    int verticalLineX;
+    int lineSpeed;
+    int fps;
+    HudText fpsText;
+} BarState;
+
+static StartupProfile aosStartup;
+
+/* '-capture <file>', frames are diffed and written out by a background process */
+static Capture aosCapture;
+
+/* '-profile <file>', also covers -batch runs */
+#define PROFILE_SAMPLES 20000
+static Profiler aosProfiler;
+
+/* Frame times of the current batch run, in microseconds */
+#define BATCH_MAX_FRAMES 2000
+static FrameTimes batchFrameTimes;
+
 static UWORD MouseCursor_NullGraphic[] = {
         0x0000, 0x0000, // reserved, must be NULL
         0x0000, 0x0000, // 1 row of image data
         0x0000, 0x0000  // reserved, must be NULL
 };
 
-static u16 PaletteColours[3] = {
-        0x0000, // background
-        0x0fff, // bars
-        0x04f4, // text
+static unsigned long PaletteColours[3] = {
+        0x000000, // background
+        0xffffff, // bars
+        0x44ff44, // text
 };
 
-void AOS_cleanupAndExit(int exitCode) {
+// Fade in from black over the first frames, only changed entries are sent to the display each frame
+#define FADE_IN_FRAMES 50
+
+static Palette palette;
+
+static HudFont hudFont;
+
+static VBlank aosVBlank;
+
+void AOS_closeDisplay() {
     if (aosWindow) {
         ClearPointer(aosWindow);
         CloseWindow(aosWindow);
@@ -73,6 +146,23 @@ void AOS_cleanupAndExit(int exitCode) {
         aosScreen = 0;
     }
 
+    Palette_free(&palette);
+}
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+    Profiler_close(&aosProfiler);
+    Capture_close(&aosCapture);
+
+    if (aosVBlank.open) {
+        VBlank_close(&aosVBlank);
+        VBlank_print(&aosVBlank);
+    }
+
+    AOS_closeDisplay();
+
+    FrameTimes_free(&batchFrameTimes);
+
     if (AslBase) {
         CloseLibrary(AslBase);
     }
@@ -90,38 +180,67 @@ void AOS_cleanupAndExit(int exitCode) {
     }
 
     if (TimerDevice.io_Device) {
+        Startup_print(&aosStartup);
+        Counters_print();
         CloseDevice(&TimerDevice);
     }
 
     exit(exitCode);
 }
 
+static int AOS_isRTGLut8Mode(ULONG displayModeId) {
+    return IsCyberModeID(displayModeId) && GetCyberIDAttr(CYBRIDATTR_DEPTH, displayModeId) == 8;
+}
+
 // GCC Hooks handling - other compilers require different syntax see hooks.h
 ULONG Hook_OnlyRTGModes(register struct Hook* hook __asm("a0"),
                         register struct ScreenModeRequester* smr __asm("a2"),
                         register ULONG displayModeId __asm("a1")) {
-    return IsCyberModeID(displayModeId) && GetCyberIDAttr(CYBRIDATTR_DEPTH, displayModeId) == 8;
+    return AOS_isRTGLut8Mode(displayModeId);
 }
 
-void AOS_init() {
-    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
-        AOS_cleanupAndExit(0);
+/*
+ * Opens what every run needs, returns FALSE if something is missing.  timer.device goes first so the other
+ * phases can be timed, asl.library is left to AOS_selectMode().
+ */
+int AOS_init() {
+    if (OpenDevice((CONST_STRPTR)"timer.device", UNIT_MICROHZ, &TimerDevice, 0) != 0) {
+        TimerDevice.io_Device = NULL;
+        return FALSE;
     }
+    TimerBase = TimerDevice.io_Device;
 
-    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 0))) {
-        AOS_cleanupAndExit(0);
+    Startup_begin(&aosStartup);
+
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        return FALSE;
     }
+    Startup_mark(&aosStartup, "intuition.library");
 
-    if (!(AslBase = OpenLibrary((UBYTE*) "asl.library", 38))) {
-        AOS_cleanupAndExit(0);
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 39))) {
+        return FALSE;
     }
+    Startup_mark(&aosStartup, "graphics.library");
 
     if (!(CyberGfxBase = OpenLibrary("cybergraphics.library", 41))) {
-        AOS_cleanupAndExit(0);
+        return FALSE;
     }
+    Startup_mark(&aosStartup, "cybergraphics.library");
 
+    return TRUE;
+}
+
+/* Ask the user for a mode, asl.library is only opened here so batch / -mode runs never need it */
+ULONG AOS_selectMode() {
     ULONG modeId = INVALID_ID;
 
+    if (!AslBase) {
+        if (!(AslBase = OpenLibrary((UBYTE*) "asl.library", 38))) {
+            return INVALID_ID;
+        }
+        Startup_mark(&aosStartup, "asl.library");
+    }
+
     struct Hook screenModeFilterHook;
     screenModeFilterHook.h_Entry = (HOOKFUNC) Hook_OnlyRTGModes;
     screenModeFilterHook.h_SubEntry = NULL;
@@ -144,13 +263,14 @@ void AOS_init() {
         FreeAslRequest(smr);
     }
 
+    return modeId;
+}
+
+/* Open screen + window in 'modeId', returns FALSE if anything fails (AOS_closeDisplay() cleans up) */
+int AOS_openDisplay(ULONG modeId) {
     screenWidth = GetCyberIDAttr(CYBRIDATTR_WIDTH, modeId);
     screenHeight = GetCyberIDAttr(CYBRIDATTR_HEIGHT, modeId);
 
-    if (modeId == INVALID_ID) {
-        AOS_cleanupAndExit(0);
-    }
-
     aosScreen = OpenScreenTags(NULL,
                                SA_Depth, 8,
                                SA_DisplayID, modeId,
@@ -165,10 +285,22 @@ void AOS_init() {
                                TAG_END);
 
     if (aosScreen == NULL) {
-        AOS_cleanupAndExit(0);
+        return FALSE;
+    }
+    Startup_mark(&aosStartup, "OpenScreenTags");
+
+    if (!Palette_init(&palette, 3)) {
+        return FALSE;
+    }
+    Startup_mark(&aosStartup, "palette buffers");
+
+    if (!Palette_buildFade(&palette, PaletteColours, NULL, FADE_IN_FRAMES)) {
+        return FALSE;
     }
+    Startup_mark(&aosStartup, "fade table build");
 
-    LoadRGB4(&aosScreen->ViewPort, PaletteColours, 3);
+    Palette_fadeTo(&palette, FADE_IN_FRAMES);
+    Palette_upload(&palette, &aosScreen->ViewPort);
 
     aosWindow = OpenWindowTags(NULL,
                                WA_Left, 0,
@@ -190,44 +322,54 @@ void AOS_init() {
                                TAG_DONE);
 
     if (!aosWindow) {
-        AOS_cleanupAndExit(0);
+        return FALSE;
     }
+    Startup_mark(&aosStartup, "OpenWindowTags");
+
+    Input_attach(&aosInput, aosWindow);
 
     // Empty pointer
     SetPointer(aosWindow, MouseCursor_NullGraphic, 1, 16, 0, 0);
 
-    OpenDevice((CONST_STRPTR)"timer.device", 0, &TimerDevice, 0);
-    TimerBase = TimerDevice.io_Device;
+    if (!Hud_initFont(&hudFont, &aosScreen->RastPort, "0123456789 fps")) {
+        return FALSE;
+    }
+    Startup_mark(&aosStartup, "hud glyph cache");
+
+    return TRUE;
 }
 
 static int AOS_processEvents() {
-    struct IntuiMessage* msg;
     int close = FALSE;
 
-    while ((msg = (struct IntuiMessage*) GetMsg(aosWindow->UserPort))) {
-        switch (msg->Class) {
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
             case IDCMP_CLOSEWINDOW:
                 close = TRUE;
                 break;
             case IDCMP_RAWKEY: {
-                WORD code = msg->Code & ~IECODE_UP_PREFIX;
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
                 if (code == KC_ESC) {
                     close = TRUE;
                 }
                 break;
             }
             case IDCMP_MOUSEBUTTONS: {
-                WORD code = msg->Code;
+                WORD code = msg->code;
                 if (code == SELECTDOWN) {
                     close = TRUE;
                 }
                 break;
             }
         }
-        ReplyMsg((struct Message*) msg);
     }
 
-    return !close;
+    return !close && !aosReplay.finished;
 }
 
 u64 AOS_GetClockCount() {
@@ -236,86 +378,275 @@ u64 AOS_GetClockCount() {
     return (((u64) clock.ev_hi) << 32u) | clock.ev_lo;
 }
 
-ULONG AOS_GetClockCountAndInterval(ULONG* tickInterval) {
+u64 AOS_GetClockCountAndInterval(ULONG* tickInterval) {
     struct EClockVal clock;
     *tickInterval = ReadEClock(&clock);
     return (((u64) clock.ev_hi) << 32u) | clock.ev_lo;
 }
 
-int main(int argc, char** argv) {
-    AOS_init();
-    struct RastPort* rastPort = &aosScreen->RastPort;
+void initBars(BarState* bars) {
+    bars->verticalLineX = 0;
+    bars->lineSpeed = screenWidth / 100;
+    bars->fps = 0;
+    HudText_init(&bars->fpsText, &hudFont, 10, 10, 2, 0, " fps");
+}
+
+/* Draw one frame of moving bars straight into the screen bitmap, returns the number of bytes written */
+ULONG renderBars(BarState* bars, struct RastPort* rastPort) {
+    u8* buffer = NULL;
+    ULONG bytesPerRow = 0;
+    ULONG pixelFormat = 0;
+    ULONG bytesWritten = 0;
+
+    APTR handle = Counters_LockBitMapTags(rastPort->BitMap,
+                                          LBMI_BASEADDRESS, (ULONG) &buffer,
+                                          LBMI_BYTESPERROW, (ULONG) &bytesPerRow,
+                                          LBMI_PIXFMT, (ULONG) &pixelFormat,
+                                          TAG_DONE);
+    bars->verticalLineX += bars->lineSpeed;
+    if (bars->verticalLineX >= screenWidth - 16) {
+        bars->verticalLineX = screenWidth - 17;
+        bars->lineSpeed = -bars->lineSpeed;
+    }
 
-    int verticalLineX = 0;
-    int lineSpeed = screenWidth / 100;
+    if (bars->verticalLineX < 0) {
+        bars->verticalLineX = 0;
+        bars->lineSpeed = -bars->lineSpeed;
+    }
 
-    int frames = 0;
-    int fps = 0;
-    ULONG updateFpsTimer = 0;
+    if (handle && buffer) {
+        if (pixelFormat != PIXFMT_LUT8) {
+            Counters_UnLockBitMap(handle);
+            printf("Pixel format not supported: %d\n", pixelFormat);
+            AOS_cleanupAndExit(0);
+        }
+
+        barTarget.base = buffer;
+        if (!barKernels || barTarget.width != screenWidth || barTarget.height != screenHeight ||
+            barTarget.bytesPerRow != (int) bytesPerRow) {
+            barTarget.width = screenWidth;
+            barTarget.height = screenHeight;
+            barTarget.bytesPerRow = (int) bytesPerRow;
+            barTarget.bitsPerPixel = 8;
+            barKernels = Kernels_select(&barTarget);
+        }
+
+        int x = bars->verticalLineX;
+        for (int i = 0; i < screenHeight; i++) {
+            barKernels->span(&barTarget, i, 0, x, 0);
+            barKernels->span(&barTarget, i, x, x + 4, 1);
+            barKernels->span(&barTarget, i, x + 4, x + 12, 0);
+            barKernels->span(&barTarget, i, x + 12, x + 16, 1);
+            barKernels->span(&barTarget, i, x + 16, screenWidth, 0);
+        }
+        bytesWritten = screenWidth * screenHeight;
+        Counters_pixels(bytesWritten);
+        Counters_bytes(bytesWritten);
+
+        if (bars->fps > 0) {
+            HudText_setNumber(&bars->fpsText, &hudFont, bars->fps);
+            Hud_drawChunky(&hudFont, &bars->fpsText, buffer, bytesPerRow, screenWidth, screenHeight);
+        }
+
+        if (Capture_isOpen(&aosCapture)) {
+            Capture_setPalette(&aosCapture, palette.colours, palette.numColours);
+            Capture_frame(&aosCapture, &buffer, bytesPerRow);
+        }
+
+        Counters_UnLockBitMap(handle);
+    }
+
+    if (palette.fadeStep > 0) {
+        Palette_fadeTo(&palette, palette.fadeStep - 1);
+    }
+    Palette_upload(&palette, &aosScreen->ViewPort);
+
+    return bytesWritten;
+}
+
+static const char* pixelFormatName(ULONG pixelFormat) {
+    static const char* names[] = {
+            "LUT8", "RGB15", "BGR15", "RGB15PC", "BGR15PC", "RGB16", "BGR16", "RGB16PC", "BGR16PC",
+            "RGB24", "BGR24", "ARGB32", "BGRA32", "RGBA32"
+    };
+    return pixelFormat < sizeof(names) / sizeof(names[0]) ? names[pixelFormat] : "?";
+}
+
+/*
+ * Run the bar renderer for 'numFrames' frames in every 8bit RTG mode, as fast as possible (no WaitTOF),
+ * and print fps, frame time percentiles and bytes written per second for each.
+ */
+void AOS_runBatch(int numFrames, const char* reportPath) {
+    FILE* report = NULL;
     ULONG tickInterval = 0;
-    char frameRateString[32];
 
-    u64 prevClock = AOS_GetClockCountAndInterval(&tickInterval);
+    if (numFrames > BATCH_MAX_FRAMES) {
+        numFrames = BATCH_MAX_FRAMES;
+    }
 
-    while (AOS_processEvents()) {
-        u8* buffer = NULL;
-        ULONG bytesPerRow = 0;
-        ULONG pixelFormat = 0;
-
-        WaitTOF();
-
-        APTR handle = LockBitMapTags(rastPort->BitMap,
-                                     LBMI_BASEADDRESS, (ULONG) &buffer,
-                                     LBMI_BYTESPERROW, (ULONG) &bytesPerRow,
-                                     LBMI_PIXFMT, (ULONG) &pixelFormat,
-                                     TAG_DONE);
-        verticalLineX += lineSpeed;
-        if (verticalLineX >= screenWidth - 16) {
-            verticalLineX = screenWidth - 17;
-            lineSpeed = -lineSpeed;
+    if (!FrameTimes_init(&batchFrameTimes, numFrames)) {
+        return;
+    }
+    Startup_mark(&aosStartup, "frame time buffers");
+
+    if (reportPath && !(report = fopen(reportPath, "w"))) {
+        printf("Can't open report file %s\n", reportPath);
+    }
+
+    static const char* header = "mode       width height format  frames   fps   p50us   p95us   p99us   maxus     KB/s kernels\n";
+    printf("%s", header);
+    if (report) {
+        fprintf(report, "%s", header);
+    }
+
+    AOS_GetClockCountAndInterval(&tickInterval);
+
+    for (ULONG modeId = NextDisplayInfo(INVALID_ID); modeId != INVALID_ID; modeId = NextDisplayInfo(modeId)) {
+        if (!AOS_isRTGLut8Mode(modeId)) {
+            continue;
         }
 
-        if (verticalLineX < 0) {
-            verticalLineX = 0;
-            lineSpeed = -lineSpeed;
+        if (!AOS_openDisplay(modeId)) {
+            printf("0x%08lx failed to open\n", modeId);
+            AOS_closeDisplay();
+            continue;
         }
 
-        if (handle && buffer) {
-            if (pixelFormat != PIXFMT_LUT8) {
-                UnLockBitMap(handle);
-                printf("Pixel format not supported: %d\n", pixelFormat);
-                AOS_cleanupAndExit(0);
-            }
+        BarState bars;
+        initBars(&bars);
+        FrameTimes_reset(&batchFrameTimes);
 
-            u8* bufferLine = buffer;
-            for (int i = 0; i < screenHeight; i++) {
-                int j = 0;
-                int end = verticalLineX;
-                for (; j < end && j < screenWidth; j++) {
-                    bufferLine[j] = 0;
-                }
-                end += 4;
-                for (; j < end && j < screenWidth; j++) {
-                    bufferLine[j] = 1;
-                }
-                end += 8;
-                for (; j < end && j < screenWidth; j++) {
-                    bufferLine[j] = 0;
-                }
-                end += 4;
-                for (; j < end && j < screenWidth; j++) {
-                    bufferLine[j] = 1;
-                }
-                for (; j < screenWidth; j++) {
-                    bufferLine[j] = 0;
-                }
+        u64 bytesWritten = 0;
+        int aborted = FALSE;
+        u64 startClock = AOS_GetClockCount();
+        u64 prevClock = startClock;
 
-                bufferLine += bytesPerRow;
+        for (int frame = 0; frame < numFrames; frame++) {
+            if (!AOS_processEvents()) {
+                aborted = TRUE;
+                break;
             }
 
-            UnLockBitMap(handle);
+            bytesWritten += renderBars(&bars, &aosScreen->RastPort);
+            Startup_firstFrame(&aosStartup);
+            Counters_endFrame();
+
+            u64 currentClock = AOS_GetClockCount();
+            FrameTimes_add(&batchFrameTimes, (ULONG) ((currentClock - prevClock) * 1000000 / tickInterval));
+            prevClock = currentClock;
+        }
+
+        ULONG totalMs = (ULONG) ((prevClock - startClock) * 1000 / tickInterval);
+        if (!totalMs) {
+            totalMs = 1;
+        }
+
+        FrameTimes_sort(&batchFrameTimes);
+
+        char line[160];
+        snprintf(line, sizeof(line), "0x%08lx %5d  %5d %-7s %6lu %5lu %7lu %7lu %7lu %7lu %8lu %s\n",
+                 modeId, screenWidth, screenHeight, pixelFormatName(GetCyberIDAttr(CYBRIDATTR_PIXFMT, modeId)),
+                 batchFrameTimes.frames, batchFrameTimes.frames * 1000 / totalMs,
+                 FrameTimes_percentile(&batchFrameTimes, 50),
+                 FrameTimes_percentile(&batchFrameTimes, 95),
+                 FrameTimes_percentile(&batchFrameTimes, 99),
+                 FrameTimes_percentile(&batchFrameTimes, 100),
+                 (ULONG) (bytesWritten * 1000 / 1024 / totalMs), barKernels ? barKernels->name : "-");
+        printf("%s", line);
+        if (report) {
+            fprintf(report, "%s", line);
         }
 
+        AOS_closeDisplay();
+
+        if (aborted) {
+            break;
+        }
+    }
+
+    if (report) {
+        fclose(report);
+    }
+}
+
+int main(int argc, char** argv) {
+    ULONG modeId = INVALID_ID;
+    int batchFrames = 0;
+    const char* reportPath = NULL;
+    const char* capturePath = NULL;
+    const char* profilePath = NULL;
+    ULONG profileInterval = 0;
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-mode") == 0) {
+            modeId = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            batchFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-report") == 0) {
+            reportPath = argv[++i];
+        } else if (strcmp(argv[i], "-capture") == 0) {
+            capturePath = argv[++i];
+        } else if (strcmp(argv[i], "-profile") == 0) {
+            profilePath = argv[++i];
+        } else if (strcmp(argv[i], "-profinterval") == 0) {
+            profileInterval = strtoul(argv[++i], NULL, 0);
+        }
+    }
+
+    if (!AOS_init()) {
+        printf("Needs intuition + graphics V39, cybergraphics V41 and timer.device\n");
+        AOS_cleanupAndExit(0);
+    }
+
+    if (profilePath && !Profiler_open(&aosProfiler, profilePath, profileInterval, PROFILE_SAMPLES,
+                                      (void (*)()) main)) {
+        printf("Can't start the profiler\n");
+    }
+
+    if (batchFrames > 0) {
+        AOS_runBatch(batchFrames, reportPath);
+        AOS_cleanupAndExit(0);
+    }
+
+    if (modeId == INVALID_ID) {
+        modeId = AOS_selectMode();
+    }
+    Startup_mark(&aosStartup, "mode selection");
+
+    if (modeId == INVALID_ID || !AOS_openDisplay(modeId)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (capturePath && !Capture_open(&aosCapture, capturePath, screenWidth, screenHeight, CAPTURE_CHUNKY, 8)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!VBlank_open(&aosVBlank)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    struct RastPort* rastPort = &aosScreen->RastPort;
+    BarState bars;
+
+    int frames = 0;
+    ULONG updateFpsTimer = 0;
+    ULONG tickInterval = 0;
+
+    initBars(&bars);
+
+    u64 prevClock = AOS_GetClockCountAndInterval(&tickInterval);
+
+    while (AOS_processEvents()) {
+        VBlank_nextFrame(&aosVBlank, 1);
+
+        renderBars(&bars, rastPort);
+        Startup_firstFrame(&aosStartup);
+        Counters_endFrame();
+
         frames++;
 
         u64 currentClock = AOS_GetClockCount();
@@ -323,19 +654,10 @@ int main(int argc, char** argv) {
         prevClock = currentClock;
         updateFpsTimer += elapsed;
         if (updateFpsTimer > 1000) {
-            fps = frames - 1;
+            bars.fps = frames - 1;
             frames = 0;
             updateFpsTimer = updateFpsTimer - 1000;
         }
-
-        if (fps > 0) {
-            snprintf(frameRateString, 32, "%ld fps", fps);
-
-            SetAPen(rastPort, 2);
-            SetBPen(rastPort, 0);
-            Move(rastPort, 10, 10);
-            Text(rastPort, (CONST_STRPTR)frameRateString, strlen(frameRateString));
-        }
     }
 
     AOS_cleanupAndExit(0);
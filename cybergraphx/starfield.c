@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <devices/timer.h>
+
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+#include <clib/timer_protos.h>
+
+#include <cybergraphx/cybergraphics.h>
+#include <inline/cybergraphics.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/palette.h"
+#include "../common/frametime.h"
+#include "../common/startup.h"
+#include "../common/vblank.h"
+#include "../common/kernels.h"
+#include "../common/points3d.h"
+
+#define KC_ESC 0x45
+
+#define DEFAULT_POINTS 4096
+#define STAR_RANGE 2048
+#define STAR_SPEED 8
+#define NEAR_Z 16
+#define NUM_SHADES 16
+#define FRAME_MICROS 20000
+
+/*
+ * Rotating 3D starfield on an 8bit RTG screen, drawn by the common/points3d.h engine.
+ *
+ * Every frame the stars fly towards the camera, the whole field turns, and every star is rotated, projected,
+ * depth sorted and plotted through the pixel kernel picked for the screen (common/kernels.h), in one of
+ * NUM_SHADES greys by distance.  The time per frame of each stage and the number of points that would fit in
+ * a 50 Hz frame at that rate are printed on exit.
+ *
+ * Command line:
+ *   -mode <id>         use this display mode id instead of the best 320 x 256 8bit one
+ *   -points <n>        number of stars, 4096 by default
+ *   -nosort            plot in transform order instead of back to front
+ *   -bench             run flat out instead of at the display rate
+ *   -record / -replay  see common/replay.h
+ */
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+static struct Library* CyberGfxBase;
+static struct IORequest TimerDevice;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static VBlank aosVBlank;
+
+static UWORD MouseCursor_NullGraphic[] = {
+        0x0000, 0x0000, // reserved, must be NULL
+        0x0000, 0x0000, // 1 row of image data
+        0x0000, 0x0000  // reserved, must be NULL
+};
+
+static Palette palette;
+
+static Points3D stars;
+static KernelTarget target;
+static const Kernels* kernels;
+
+static FrameTimes workTimes;
+static unsigned long frames = 0;
+static unsigned long visible = 0;
+static unsigned long long transformTicks = 0;
+static unsigned long long sortTicks = 0;
+static unsigned long long drawTicks = 0;
+static unsigned long ticksPerSecond = 1;
+
+static unsigned long AOS_micros(unsigned long long ticks) {
+    return (unsigned long) (ticks * 1000000 / ticksPerSecond);
+}
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
+    if (aosVBlank.open) {
+        VBlank_close(&aosVBlank);
+        VBlank_print(&aosVBlank);
+    }
+
+    if (frames) {
+        unsigned long work = AOS_micros(transformTicks + sortTicks + drawTicks);
+        printf("%lu frames, %d stars, %lu visible per frame, kernels %s\n", frames, stars.count,
+               visible / frames, kernels ? kernels->name : "-");
+        printf("per frame: transform %lu us, sort %lu us, clear + draw %lu us\n",
+               AOS_micros(transformTicks) / frames, AOS_micros(sortTicks) / frames,
+               AOS_micros(drawTicks) / frames);
+        if (work) {
+            printf("%lu points per 50 Hz frame (transform + sort + draw)\n",
+                   (unsigned long) ((unsigned long long) stars.count * frames * FRAME_MICROS / work));
+        }
+        FrameTimes_sort(&workTimes);
+        printf("work per frame p50 %lu us, p99 %lu us\n", FrameTimes_percentile(&workTimes, 50),
+               FrameTimes_percentile(&workTimes, 99));
+    }
+
+    if (aosWindow) {
+        ClearPointer(aosWindow);
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosScreen) {
+        CloseScreen(aosScreen);
+        aosScreen = 0;
+    }
+
+    Points3D_free(&stars);
+    Palette_free(&palette);
+    FrameTimes_free(&workTimes);
+    Mem_printUsage();
+
+    if (CyberGfxBase) {
+        CloseLibrary(CyberGfxBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (TimerDevice.io_Device) {
+        CloseDevice(&TimerDevice);
+    }
+
+    exit(exitCode);
+}
+
+void AOS_init(ULONG modeId) {
+    if (OpenDevice((CONST_STRPTR)"timer.device", UNIT_MICROHZ, &TimerDevice, 0) != 0) {
+        TimerDevice.io_Device = NULL;
+        AOS_cleanupAndExit(0);
+    }
+    TimerBase = TimerDevice.io_Device;
+
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(CyberGfxBase = OpenLibrary("cybergraphics.library", 41))) {
+        printf("Needs cybergraphics.library V41\n");
+        AOS_cleanupAndExit(0);
+    }
+
+    if (modeId == INVALID_ID) {
+        modeId = BestCModeIDTags(CYBRBIDTG_NominalWidth, 320,
+                                 CYBRBIDTG_NominalHeight, 256,
+                                 CYBRBIDTG_Depth, 8,
+                                 TAG_DONE);
+    }
+
+    if (modeId == INVALID_ID || !IsCyberModeID(modeId) || GetCyberIDAttr(CYBRIDATTR_DEPTH, modeId) != 8) {
+        printf("No 8bit RTG mode to open\n");
+        AOS_cleanupAndExit(0);
+    }
+
+    int width = GetCyberIDAttr(CYBRIDATTR_WIDTH, modeId);
+    int height = GetCyberIDAttr(CYBRIDATTR_HEIGHT, modeId);
+
+    aosScreen = OpenScreenTags(NULL,
+                               SA_Depth, 8,
+                               SA_DisplayID, modeId,
+                               SA_Width, width,
+                               SA_Height, height,
+                               SA_Type, CUSTOMSCREEN,
+                               SA_Quiet, TRUE,
+                               SA_ShowTitle, FALSE,
+                               SA_Draggable, FALSE,
+                               SA_Exclusive, TRUE,
+                               SA_AutoScroll, FALSE,
+                               TAG_END);
+
+    if (aosScreen == NULL) {
+        AOS_cleanupAndExit(0);
+    }
+
+    /* Pen 0 black, then NUM_SHADES greys from white down */
+    if (!Palette_init(&palette, NUM_SHADES + 1)) {
+        AOS_cleanupAndExit(0);
+    }
+    Palette_set(&palette, 0, 0x000000);
+    for (int i = 0; i < NUM_SHADES; i++) {
+        unsigned long grey = 0xff - i * 0xe0 / NUM_SHADES;
+        Palette_set(&palette, i + 1, (grey << 16) | (grey << 8) | grey);
+    }
+    Palette_upload(&palette, &aosScreen->ViewPort);
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 0,
+                               WA_Top, 0,
+                               WA_Width, width,
+                               WA_Height, height,
+                               WA_CustomScreen, aosScreen,
+                               WA_Title, NULL,
+                               WA_Backdrop, TRUE,
+                               WA_Borderless, TRUE,
+                               WA_DragBar, FALSE,
+                               WA_Activate, TRUE,
+                               WA_SmartRefresh, TRUE,
+                               WA_NoCareRefresh, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_IDCMP, IDCMP_RAWKEY | IDCMP_MOUSEBUTTONS,
+                               TAG_DONE);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Input_attach(&aosInput, aosWindow);
+
+    // Empty pointer
+    SetPointer(aosWindow, MouseCursor_NullGraphic, 1, 16, 0, 0);
+}
+
+void initStars(int numStars) {
+    unsigned char shades[NUM_SHADES];
+
+    if (!Points3D_init(&stars, numStars, aosScreen->Width, aosScreen->Height, aosScreen->Width / 2, NEAR_Z,
+                       STAR_RANGE * 2 + NEAR_Z) ||
+        !FrameTimes_init(&workTimes, 1000)) {
+        printf("Out of memory\n");
+        AOS_cleanupAndExit(0);
+    }
+
+    for (int i = 0; i < NUM_SHADES; i++) {
+        shades[i] = (unsigned char) (i + 1);
+    }
+    Points3D_setShades(&stars, shades, NUM_SHADES, STAR_RANGE * 2);
+    stars.cameraZ = STAR_RANGE + NEAR_Z;
+
+    srand(4);
+    for (int i = 0; i < numStars; i++) {
+        Points3D_add(&stars, rand() % (STAR_RANGE * 2) - STAR_RANGE, rand() % (STAR_RANGE * 2) - STAR_RANGE,
+                     rand() % (STAR_RANGE * 2) - STAR_RANGE);
+    }
+}
+
+/* Clear and plot the transformed stars straight into the screen bitmap */
+void drawStars(struct RastPort* rastPort) {
+    UBYTE* buffer = NULL;
+    ULONG bytesPerRow = 0;
+    ULONG pixelFormat = 0;
+
+    APTR handle = LockBitMapTags(rastPort->BitMap,
+                                 LBMI_BASEADDRESS, (ULONG) &buffer,
+                                 LBMI_BYTESPERROW, (ULONG) &bytesPerRow,
+                                 LBMI_PIXFMT, (ULONG) &pixelFormat,
+                                 TAG_DONE);
+    if (!handle) {
+        return;
+    }
+
+    if (pixelFormat != PIXFMT_LUT8) {
+        UnLockBitMap(handle);
+        printf("Pixel format not supported: %lu\n", pixelFormat);
+        AOS_cleanupAndExit(0);
+    }
+
+    target.base = buffer;
+    if (!kernels || target.bytesPerRow != (int) bytesPerRow) {
+        target.width = aosScreen->Width;
+        target.height = aosScreen->Height;
+        target.bytesPerRow = (int) bytesPerRow;
+        target.bitsPerPixel = 8;
+        kernels = Kernels_select(&target);
+    }
+
+    kernels->clear(&target, 0);
+    Points3D_draw(&stars, kernels, &target);
+
+    UnLockBitMap(handle);
+}
+
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
+                if (code == KC_ESC) {
+                    close = TRUE;
+                }
+                break;
+            }
+            case IDCMP_MOUSEBUTTONS: {
+                WORD code = msg->code;
+                if (code == SELECTDOWN) {
+                    close = TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+int main(int argc, char** argv) {
+    ULONG modeId = INVALID_ID;
+    int numStars = DEFAULT_POINTS;
+    int sort = TRUE;
+    int bench = FALSE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-mode") == 0 && i + 1 < argc) {
+            modeId = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-points") == 0 && i + 1 < argc) {
+            numStars = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-nosort") == 0) {
+            sort = FALSE;
+        } else if (strcmp(argv[i], "-bench") == 0) {
+            bench = TRUE;
+        }
+    }
+
+    if (numStars < 1) {
+        numStars = 1;
+    }
+
+    AOS_init(modeId);
+    initStars(numStars);
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!bench && !VBlank_open(&aosVBlank)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    struct RastPort* rastPort = &aosScreen->RastPort;
+
+    while (AOS_processEvents()) {
+        if (!bench) {
+            VBlank_nextFrame(&aosVBlank, 1);
+        }
+
+        unsigned long long t0 = Startup_now(&ticksPerSecond);
+        Points3D_scroll(&stars, -STAR_SPEED, STAR_RANGE);
+        Points3D_setRotation(&stars, (int) (frames >> 2), (int) (frames >> 3), (int) frames);
+        visible += Points3D_transform(&stars);
+        unsigned long long t1 = Startup_now(&ticksPerSecond);
+        if (sort) {
+            Points3D_sort(&stars);
+        }
+        unsigned long long t2 = Startup_now(&ticksPerSecond);
+        drawStars(rastPort);
+        unsigned long long t3 = Startup_now(&ticksPerSecond);
+
+        transformTicks += t1 - t0;
+        sortTicks += t2 - t1;
+        drawTicks += t3 - t2;
+        FrameTimes_add(&workTimes, AOS_micros(t3 - t0));
+        frames++;
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}
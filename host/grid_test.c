@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/platform.h"
+#include "../common/memory.h"
+#include "../common/grid.h"
+
+#define MAX_ITEMS 2000
+
+//
+// Host tests for the common/grid.h neighbour queries.  Scatters items over a screen, some of them outside it,
+// and checks that SpatialGrid_query() finds exactly the items a brute force check over all of them finds,
+// for a range of cell sizes and radii.  Build with:
+//
+//   gcc -O2 host/grid_test.c -o build/host-grid-test
+//
+// Covers cells much smaller than the radius, much bigger than it, and cell sizes small enough that the grid
+// has to make its cells bigger to keep the cell count in range.  Prints one line per test, exits with 1 if
+// any failed.
+//
+
+typedef struct sGridCase {
+    const char* name;
+    int width;
+    int height;
+    int cellShift;
+    int radius;
+    int count;
+} GridCase;
+
+static const GridCase cases[] = {
+    {"flock", 320, 256, 4, 16, 500},
+    {"small cells", 320, 256, 2, 16, 500},
+    {"big cells", 320, 256, 7, 10, 500},
+    {"radius 1", 320, 256, 0, 1, 2000},
+    {"radius 0", 320, 256, 0, 0, 2000},
+    {"too many cells", 640, 512, 0, 3, 2000},
+    {"crowded", 64, 64, 3, 8, 2000},
+    {"wide", 1024, 8, 3, 5, 300},
+};
+
+static long x[MAX_ITEMS];
+static long y[MAX_ITEMS];
+
+/* The same test SpatialGrid_query() makes: inside the box, then squared distance in 1/16 pixels */
+static int within(long dx, long dy, int radius) {
+    long radius16 = (long) radius << 16;
+    long radiusSq = (long) (radius << 4) * (radius << 4);
+
+    if (dx > radius16 || dx < -radius16 || dy > radius16 || dy < -radius16) {
+        return FALSE;
+    }
+    dx >>= 12;
+    dy >>= 12;
+    return dx * dx + dy * dy <= radiusSq;
+}
+
+static int byIndex(const void* a, const void* b) {
+    return (int) *(const unsigned short*) a - (int) *(const unsigned short*) b;
+}
+
+static int runCase(const GridCase* test, char* why) {
+    static SpatialGrid grid;
+    static unsigned short found[MAX_ITEMS];
+    static unsigned short expected[MAX_ITEMS];
+    unsigned long total = 0;
+
+    srand((unsigned int) (test->width * 7 + test->cellShift * 13 + test->radius));
+    for (int i = 0; i < test->count; i++) {
+        /* mostly on screen, a few up to 8 pixels off each edge, some stacked on the same spot */
+        x[i] = ((long) (rand() % (test->width + 16)) - 8) * 65536 + (rand() & 0xffff);
+        y[i] = ((long) (rand() % (test->height + 16)) - 8) * 65536 + (rand() & 0xffff);
+        if (i % 50 == 49) {
+            x[i] = x[i - 1];
+            y[i] = y[i - 1];
+        }
+    }
+
+    if (!SpatialGrid_init(&grid, test->width, test->height, test->cellShift, MAX_ITEMS)) {
+        strcpy(why, "SpatialGrid_init() failed");
+        return FALSE;
+    }
+    if ((long) grid.cols * grid.rows > SPATIAL_GRID_MAX_CELLS) {
+        sprintf(why, "%d x %d cells", grid.cols, grid.rows);
+        SpatialGrid_free(&grid);
+        return FALSE;
+    }
+    SpatialGrid_build(&grid, x, y, test->count);
+
+    for (int i = 0; i < test->count; i++) {
+        int numFound = SpatialGrid_query(&grid, x[i], y[i], test->radius, found, MAX_ITEMS);
+        int numExpected = 0;
+        for (int j = 0; j < test->count; j++) {
+            if (within(x[j] - x[i], y[j] - y[i], test->radius)) {
+                expected[numExpected++] = (unsigned short) j;
+            }
+        }
+
+        qsort(found, numFound, sizeof(unsigned short), byIndex);
+        if (numFound != numExpected || memcmp(found, expected, numFound * sizeof(unsigned short)) != 0) {
+            sprintf(why, "item %d: %d found, %d expected", i, numFound, numExpected);
+            SpatialGrid_free(&grid);
+            return FALSE;
+        }
+        total += numFound;
+    }
+
+    sprintf(why, "%d x %d cells of %d, %lu found, %lu candidates", grid.cols, grid.rows, 1 << grid.cellShift,
+            total, grid.candidates);
+    SpatialGrid_free(&grid);
+    return TRUE;
+}
+
+int main() {
+    int numCases = (int) (sizeof(cases) / sizeof(cases[0]));
+    int failed = 0;
+
+    for (int i = 0; i < numCases; i++) {
+        char why[256] = "";
+        int ok = runCase(&cases[i], why);
+        printf("%-16s %s: %s\n", cases[i].name, ok ? "ok" : "FAILED", why);
+        failed += !ok;
+    }
+
+    printf("%d of %d passed\n", numCases - failed, numCases);
+    Mem_printUsage();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/platform.h"
+#include "../common/iff.h"
+
+#define MAX_WIDTH 64
+#define MAX_HEIGHT 16
+#define MAX_FILE 65536
+
+//
+// Host tests for the common/iff.h loader.  Writes a set of sample pictures, each from known pixels, reads
+// them back through the loader and checks the pixels, palette and header fields that come out.  Build with:
+//
+//   gcc -O2 host/iff_test.c -o build/host-iff-test
+//
+// host-iff-test [directory]
+//
+// The samples are written to 'directory' (default /tmp) as iff_test_<name>.iff and left there, so they can
+// also be tried on showiff.  Covers uncompressed and ByteRun1 ILBMs, a masked one, an odd width, PBM and
+// files cut short in the header and in the BODY.  Prints one line per test, exits with 1 if any failed.
+//
+
+typedef struct sSample {
+    const char* name;
+    int width;
+    int height;
+    int depth;
+    int chunky;
+    int compression;
+    int masking;
+    unsigned long viewModes;
+    int cut;                            /* bytes left off the end of the file, 0 for all of it */
+    int cutInHeader;                    /* the file ends before the BODY, Iff_open() has to refuse it */
+} Sample;
+
+static const Sample samples[] = {
+    {"plain", 16, 4, 3, FALSE, IFF_COMPRESSION_NONE, 0, 0, 0, FALSE},
+    {"byterun1", 48, 8, 4, FALSE, IFF_COMPRESSION_BYTERUN1, 0, 0x8004, 0, FALSE},
+    {"odd", 37, 11, 5, FALSE, IFF_COMPRESSION_BYTERUN1, 0, 0, 0, FALSE},
+    {"masked", 20, 6, 4, FALSE, IFF_COMPRESSION_BYTERUN1, IFF_MASK_HAS_MASK, 0, 0, FALSE},
+    {"masked_plain", 20, 6, 2, FALSE, IFF_COMPRESSION_NONE, IFF_MASK_HAS_MASK, 0, 0, FALSE},
+    {"pbm", 37, 11, 8, TRUE, IFF_COMPRESSION_BYTERUN1, 0, 0, 0, FALSE},
+    {"pbm_plain", 37, 11, 8, TRUE, IFF_COMPRESSION_NONE, 0, 0, 0, FALSE},
+    {"truncated", 37, 11, 5, FALSE, IFF_COMPRESSION_BYTERUN1, 0, 0, 40, FALSE},
+    {"truncated_pbm", 37, 11, 8, TRUE, IFF_COMPRESSION_NONE, 0, 0, 100, FALSE},
+    {"truncated_header", 16, 4, 3, FALSE, IFF_COMPRESSION_NONE, 0, 0, 0, TRUE},
+};
+
+static unsigned char file[MAX_FILE];
+static int fileSize;
+
+static unsigned char pixels[MAX_HEIGHT][MAX_WIDTH];
+static unsigned long colours[256];
+
+static void putByte(int v) {
+    file[fileSize++] = (unsigned char) v;
+}
+
+static void putWord(unsigned int v) {
+    putByte(v >> 8);
+    putByte(v & 0xff);
+}
+
+static void putLong(unsigned long v) {
+    putWord((unsigned int) (v >> 16));
+    putWord((unsigned int) (v & 0xffff));
+}
+
+static void putId(const char* id) {
+    for (int i = 0; i < 4; i++) {
+        putByte(id[i]);
+    }
+}
+
+/* Chunk header with its size patched in by endChunk() */
+static int beginChunk(const char* id) {
+    putId(id);
+    putLong(0);
+    return fileSize;
+}
+
+static void endChunk(int start) {
+    unsigned long size = (unsigned long) (fileSize - start);
+    file[start - 4] = (unsigned char) (size >> 24);
+    file[start - 3] = (unsigned char) (size >> 16);
+    file[start - 2] = (unsigned char) (size >> 8);
+    file[start - 1] = (unsigned char) size;
+    if (size & 1) {
+        putByte(0);
+    }
+}
+
+/* One row in ByteRun1: runs of 3 or more as repeats, the rest as literals of up to 128 bytes */
+static void putRow(const unsigned char* row, int length, int compression) {
+    if (compression == IFF_COMPRESSION_NONE) {
+        for (int i = 0; i < length; i++) {
+            putByte(row[i]);
+        }
+        return;
+    }
+
+    int i = 0;
+    while (i < length) {
+        int run = 1;
+        while (i + run < length && run < 128 && row[i + run] == row[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            putByte(257 - run);
+            putByte(row[i]);
+            i += run;
+            continue;
+        }
+
+        int start = i;
+        while (i < length && i - start < 128) {
+            if (i + 2 < length && row[i] == row[i + 1] && row[i] == row[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        putByte(i - start - 1);
+        for (int j = start; j < i; j++) {
+            putByte(row[j]);
+        }
+    }
+}
+
+/* Pixels with both runs and noise in them, so ByteRun1 writes repeats and literals */
+static void makePixels(const Sample* sample) {
+    unsigned int seed = (unsigned int) sample->width * 31 + (unsigned int) sample->depth;
+    int mask = (1 << sample->depth) - 1;
+
+    for (int y = 0; y < sample->height; y++) {
+        for (int x = 0; x < sample->width; x++) {
+            seed = seed * 1103515245 + 12345;
+            int v = x < sample->width / 3 ? y : (x < sample->width / 2 ? (int) (seed >> 16) : x ^ y);
+            pixels[y][x] = (unsigned char) (v & mask);
+        }
+    }
+
+    for (int i = 0; i < 256; i++) {
+        colours[i] = ((unsigned long) (i * 7 & 0xff) << 16) | ((unsigned long) (i * 13 & 0xff) << 8) |
+                     (unsigned long) (i * 29 & 0xff);
+    }
+}
+
+static void buildFile(const Sample* sample) {
+    int rowBytes = ((sample->width + 15) >> 4) * 2;
+    unsigned char row[MAX_WIDTH + 1];
+
+    fileSize = 0;
+    int form = beginChunk("FORM");
+    putId(sample->chunky ? "PBM " : "ILBM");
+
+    int chunk = beginChunk("BMHD");
+    putWord(sample->width);
+    putWord(sample->height);
+    putLong(0);
+    putByte(sample->depth);
+    putByte(sample->masking);
+    putByte(sample->compression);
+    putByte(0);
+    putWord(0);
+    putByte(10);
+    putByte(11);
+    putWord(sample->width);
+    putWord(sample->height);
+    endChunk(chunk);
+
+    /* Odd sized chunk the loader doesn't know, to check it skips the pad byte */
+    chunk = beginChunk("ANNO");
+    putId("iff_");
+    putId("test");
+    putByte('!');
+    endChunk(chunk);
+
+    chunk = beginChunk("CMAP");
+    for (int i = 0; i < 1 << sample->depth; i++) {
+        putByte((int) (colours[i] >> 16));
+        putByte((int) (colours[i] >> 8) & 0xff);
+        putByte((int) colours[i] & 0xff);
+    }
+    endChunk(chunk);
+
+    if (sample->viewModes) {
+        chunk = beginChunk("CAMG");
+        putLong(sample->viewModes);
+        endChunk(chunk);
+    }
+
+    chunk = beginChunk("BODY");
+    for (int y = 0; y < sample->height; y++) {
+        if (sample->chunky) {
+            memcpy(row, pixels[y], sample->width);
+            row[sample->width] = 0;
+            putRow(row, sample->width + (sample->width & 1), sample->compression);
+            continue;
+        }
+
+        for (int p = 0; p < sample->depth; p++) {
+            memset(row, 0, rowBytes);
+            for (int x = 0; x < sample->width; x++) {
+                if (pixels[y][x] & (1 << p)) {
+                    row[x >> 3] |= (unsigned char) (0x80 >> (x & 7));
+                }
+            }
+            putRow(row, rowBytes, sample->compression);
+        }
+        if (sample->masking == IFF_MASK_HAS_MASK) {
+            memset(row, 0xff, rowBytes);
+            row[0] = 0x5a;
+            putRow(row, rowBytes, sample->compression);
+        }
+    }
+    endChunk(chunk);
+    endChunk(form);
+
+    if (sample->cutInHeader) {
+        fileSize = 30;
+    } else {
+        fileSize -= sample->cut;
+    }
+}
+
+static int writeFile(const char* path) {
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        return FALSE;
+    }
+    int written = fwrite(file, 1, fileSize, out) == (size_t) fileSize;
+    return fclose(out) == 0 && written;
+}
+
+static int checkHeader(const Sample* sample, const IffImage* image, char* why) {
+    if (image->width != sample->width || image->height != sample->height || image->depth != sample->depth ||
+        image->chunky != sample->chunky || image->compression != sample->compression ||
+        image->masking != sample->masking || image->viewModes != sample->viewModes) {
+        sprintf(why, "header %d x %d x %d", image->width, image->height, image->depth);
+        return FALSE;
+    }
+    if (image->numColours != 1 << sample->depth) {
+        sprintf(why, "%d colours", image->numColours);
+        return FALSE;
+    }
+    for (int i = 0; i < image->numColours; i++) {
+        if (image->colours[i] != colours[i]) {
+            sprintf(why, "colour %d is %06lx", i, image->colours[i]);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Rows from 'chunky' against the source, 'rows' of them */
+static int checkChunky(const unsigned char* chunky, int bytesPerRow, int width, int rows, char* why) {
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < width; x++) {
+            if (chunky[y * bytesPerRow + x] != pixels[y][x]) {
+                sprintf(why, "pixel %d, %d is %d, not %d", x, y, chunky[y * bytesPerRow + x], pixels[y][x]);
+                return FALSE;
+            }
+        }
+        /* nothing written past 'width' */
+        if (width < bytesPerRow && chunky[y * bytesPerRow + width] != 0xee) {
+            sprintf(why, "row %d written past %d pixels", y, width);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Planes from Iff_readPlanar() against the source, 'depth' planes of 'width' pixels */
+static int checkPlanar(unsigned char* const* planes, int depth, int bytesPerRow, int width, int rows, char* why) {
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < width; x++) {
+            int v = 0;
+            for (int p = 0; p < depth; p++) {
+                if (planes[p][y * bytesPerRow + (x >> 3)] & (0x80 >> (x & 7))) {
+                    v |= 1 << p;
+                }
+            }
+            if (v != (pixels[y][x] & ((1 << depth) - 1))) {
+                sprintf(why, "planar pixel %d, %d is %d, not %d", x, y, v, pixels[y][x]);
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+static int runSample(const Sample* sample, const char* path, char* why) {
+    static IffReader reader;
+    static IffImage image;
+    static unsigned char chunky[MAX_HEIGHT * (MAX_WIDTH + 8)];
+    static unsigned char planeMemory[IFF_MAX_DEPTH][MAX_HEIGHT * 8];
+    unsigned char* planes[IFF_MAX_DEPTH];
+    int bytesPerRow = MAX_WIDTH + 8;
+    int truncated = sample->cut > 0;
+
+    int opened = Iff_open(&reader, &image, path);
+    if (sample->cutInHeader) {
+        Iff_close(&reader);
+        if (opened) {
+            strcpy(why, "opened a file that ends in the header");
+            return FALSE;
+        }
+        return TRUE;
+    }
+    if (!opened) {
+        strcpy(why, "Iff_open() failed");
+        return FALSE;
+    }
+    if (!checkHeader(sample, &image, why)) {
+        Iff_close(&reader);
+        return FALSE;
+    }
+
+    /* Every sample read as chunky pixels */
+    memset(chunky, 0xee, sizeof(chunky));
+    int complete = Iff_readChunky(&reader, &image, chunky, bytesPerRow, image.width, image.height);
+    Iff_close(&reader);
+    if (complete == truncated) {
+        strcpy(why, truncated ? "read past the end of the file" : "chunky read failed");
+        return FALSE;
+    }
+    /* a short file gives up on the row it ends in, the ones before it have to be right */
+    if (!checkChunky(chunky, bytesPerRow, image.width, truncated ? reader.rowsRead - 1 : image.height, why)) {
+        return FALSE;
+    }
+
+    /* Again clipped to 7 pixels and 3 rows, to check nothing lands past the destination */
+    if (!truncated) {
+        memset(chunky, 0xee, sizeof(chunky));
+        if (!Iff_open(&reader, &image, path) || !Iff_readChunky(&reader, &image, chunky, bytesPerRow, 7, 3)) {
+            Iff_close(&reader);
+            strcpy(why, "clipped chunky read failed");
+            return FALSE;
+        }
+        Iff_close(&reader);
+        if (!checkChunky(chunky, bytesPerRow, 7, 3, why)) {
+            return FALSE;
+        }
+        if (chunky[3 * bytesPerRow] != 0xee) {
+            strcpy(why, "clipped chunky read wrote past 3 rows");
+            return FALSE;
+        }
+    }
+
+    if (sample->chunky) {
+        return TRUE;
+    }
+
+    /* ILBMs into planes as well, all of them and then clipped to 2 planes of 1 byte (8 pixels) */
+    int planeBytes = ((sample->width + 15) >> 4) * 2;
+    for (int p = 0; p < IFF_MAX_DEPTH; p++) {
+        planes[p] = planeMemory[p];
+    }
+
+    memset(planeMemory, 0, sizeof(planeMemory));
+    if (!Iff_open(&reader, &image, path)) {
+        strcpy(why, "Iff_open() failed on the second read");
+        return FALSE;
+    }
+    complete = Iff_readPlanar(&reader, &image, planes, image.depth, planeBytes, MAX_HEIGHT);
+    Iff_close(&reader);
+    if (complete == truncated) {
+        strcpy(why, truncated ? "planar read past the end of the file" : "planar read failed");
+        return FALSE;
+    }
+    if (!checkPlanar(planes, image.depth, planeBytes, image.width, truncated ? reader.rowsRead - 1 : image.height,
+                     why)) {
+        return FALSE;
+    }
+    if (truncated) {
+        return TRUE;
+    }
+
+    memset(planeMemory, 0xee, sizeof(planeMemory));
+    if (!Iff_open(&reader, &image, path) || !Iff_readPlanar(&reader, &image, planes, 2, 1, MAX_HEIGHT)) {
+        Iff_close(&reader);
+        strcpy(why, "clipped planar read failed");
+        return FALSE;
+    }
+    Iff_close(&reader);
+    if (!checkPlanar(planes, 2, 1, 8, image.height, why)) {
+        return FALSE;
+    }
+    if (planeMemory[2][0] != 0xee || planeMemory[0][image.height] != 0xee) {
+        strcpy(why, "clipped planar read wrote past the destination");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+int main(int argc, char** argv) {
+    const char* directory = argc > 1 ? argv[1] : "/tmp";
+    int numSamples = (int) (sizeof(samples) / sizeof(samples[0]));
+    int failed = 0;
+
+    for (int i = 0; i < numSamples; i++) {
+        const Sample* sample = &samples[i];
+        char path[1024];
+        char why[256] = "";
+
+        snprintf(path, sizeof(path), "%s/iff_test_%s.iff", directory, sample->name);
+        makePixels(sample);
+        buildFile(sample);
+        if (!writeFile(path)) {
+            printf("Can't write %s\n", path);
+            return 1;
+        }
+
+        int ok = runSample(sample, path, why);
+        printf("%-18s %2d x %2d x %d  %s%s\n", sample->name, sample->width, sample->height, sample->depth,
+               ok ? "ok" : "FAILED: ", why);
+        failed += !ok;
+    }
+
+    printf("%d of %d passed\n", numSamples - failed, numSamples);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+/* REG_RIP etc. in <ucontext.h>, for common/profiler.h */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+
+#include "../common/platform.h"
+#include "../common/memory.h"
+#include "../common/flock.h"
+#include "../common/raster.h"
+#include "../common/frametime.h"
+#include "../common/shmframes.h"
+#include "../common/vblank.h"
+#include "../common/profiler.h"
+
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 256
+#define DEFAULT_INSECTS 500
+#define NUM_POLYGONS 8
+#define NEIGHBOUR_RADIUS 16
+#define PROFILE_SAMPLES 100000
+
+//
+// Headless host run of the demo code: flocking insects over spinning polygons, drawn by the common/ modules
+// into an 8 bit chunky buffer as fast as possible.  Meant for long soak runs and for profiling the shared
+// code without an Amiga.
+//
+// Frames are drawn straight into a shared memory ring (common/shmframes.h), watch them live with
+// tools/shmview.  Build with:
+//
+//   gcc -O2 host/insects.c -lm -lpthread -lrt -o build/host-insects
+//
+// host-insects [-frames <n>] [-insects <n>] [-shm <name>] [-slots <n>] [-noshm] [-vblank]
+//              [-profile <file> [-profinterval <us>]]
+//
+// '-vblank' paces frames to the common/vblank.h timer thread instead of running flat out.
+//
+// '-profile' samples where the time goes (common/profiler.h), add it up per function with tools/profmap.
+//
+
+typedef struct sSpinner {
+    short cx;
+    short cy;
+    short radius;
+    short numVertices;
+    double angle;
+    double spin;
+    int colour;
+} Spinner;
+
+static unsigned long colours[8] = {
+    0x000010, 0xffff00, 0x402060, 0x204080, 0x206040, 0x604020, 0x303030, 0xffffff
+};
+
+static volatile sig_atomic_t hostQuit = 0;
+
+static void Host_onSignal(int sig) {
+    hostQuit = 1;
+}
+
+static unsigned long long Host_micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void initSpinners(Spinner* spinners) {
+    for (int i = 0; i < NUM_POLYGONS; i++) {
+        Spinner* s = &spinners[i];
+        s->cx = rand() % SCREEN_WIDTH;
+        s->cy = rand() % SCREEN_HEIGHT;
+        s->radius = rand() % 50 + 20;
+        s->numVertices = rand() % 4 + 3;
+        s->angle = 0;
+        s->spin = (rand() % 100 - 50) / 1000.0;
+        s->colour = i % 5 + 2;
+    }
+}
+
+static void drawFrame(RasterTarget* target, Spinner* spinners, Flock* flock) {
+    short xs[8];
+    short ys[8];
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        memset(target->chunky + y * target->bytesPerRow, 0, SCREEN_WIDTH);
+    }
+
+    for (int i = 0; i < NUM_POLYGONS; i++) {
+        Spinner* s = &spinners[i];
+        for (int v = 0; v < s->numVertices; v++) {
+            double a = s->angle + v * M_PI * 2 / s->numVertices;
+            xs[v] = (short) (s->cx + s->radius * cos(a));
+            ys[v] = (short) (s->cy + s->radius * sin(a));
+        }
+        s->angle += s->spin;
+        Raster_polygon(target, xs, ys, s->numVertices, s->colour);
+    }
+
+    for (int i = 0; i < flock->count; i++) {
+        int x = flock->x[i] >> 16;
+        int y = flock->y[i] >> 16;
+        Raster_span(target, y, x, x + 2, 1);
+        Raster_span(target, y + 1, x, x + 2, 1);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long maxFrames = 0;
+    int numInsects = DEFAULT_INSECTS;
+    const char* shmName = "/aos-frames";
+    int numSlots = 3;
+    int useShm = TRUE;
+    int useVBlank = FALSE;
+    const char* profilePath = NULL;
+    unsigned long profileInterval = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            maxFrames = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-insects") == 0 && i + 1 < argc) {
+            numInsects = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc) {
+            shmName = argv[++i];
+        } else if (strcmp(argv[i], "-slots") == 0 && i + 1 < argc) {
+            numSlots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-noshm") == 0) {
+            useShm = FALSE;
+        } else if (strcmp(argv[i], "-vblank") == 0) {
+            useVBlank = TRUE;
+        } else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (strcmp(argv[i], "-profinterval") == 0 && i + 1 < argc) {
+            profileInterval = strtoul(argv[++i], NULL, 0);
+        }
+    }
+
+    static Flock flock;
+    static RasterTarget target;
+    static ShmFrames shm;
+    static FrameTimes frameTimes;
+    static VBlank vblank;
+    static Profiler profiler;
+    Spinner spinners[NUM_POLYGONS];
+    unsigned char* localBuffer = NULL;
+    int bytesPerRow = SCREEN_WIDTH;
+
+    if (!Flock_init(&flock, numInsects, SCREEN_WIDTH, SCREEN_HEIGHT, NEIGHBOUR_RADIUS) ||
+        !FrameTimes_init(&frameTimes, 1000)) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    if (useShm) {
+        if (!ShmFrames_create(&shm, shmName, SCREEN_WIDTH, SCREEN_HEIGHT, numSlots)) {
+            printf("Can't create shared memory %s\n", shmName);
+            return 1;
+        }
+        ShmFrames_setPalette(&shm, colours, 8);
+        bytesPerRow = shm.header->bytesPerRow;
+        printf("frames in shared memory %s, %d slots\n", shmName, shm.header->numSlots);
+    } else if (!(localBuffer = Mem_alloc(SCREEN_WIDTH * SCREEN_HEIGHT, MEM_FOR_DISPLAY, TRUE))) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    if (useVBlank && !VBlank_open(&vblank)) {
+        printf("Can't start the vblank thread\n");
+        return 1;
+    }
+
+    if (profilePath && !Profiler_open(&profiler, profilePath, profileInterval, PROFILE_SAMPLES, (void (*)()) main)) {
+        printf("Can't start the profiler\n");
+        return 1;
+    }
+
+    signal(SIGINT, Host_onSignal);
+    signal(SIGTERM, Host_onSignal);
+
+    srand(4);
+    for (int i = 0; i < numInsects; i++) {
+        double angle = (rand() % 256) * M_PI * 2 / 256;
+        Flock_add(&flock, (long) (rand() % SCREEN_WIDTH) << 16, (long) (rand() % SCREEN_HEIGHT) << 16,
+                  (long) (2 * 65536 * cos(angle)), (long) (2 * 65536 * sin(angle)));
+    }
+    initSpinners(spinners);
+
+    unsigned long frames = 0;
+    unsigned long long start = Host_micros();
+    unsigned long long prev = start;
+
+    while (!hostQuit && (!maxFrames || frames < maxFrames)) {
+        if (useVBlank) {
+            VBlank_nextFrame(&vblank, 1);
+        }
+
+        unsigned char* buffer = useShm ? ShmFrames_begin(&shm) : localBuffer;
+
+        Flock_update(&flock);
+        Raster_initChunky(&target, buffer, bytesPerRow, SCREEN_WIDTH, SCREEN_HEIGHT);
+        drawFrame(&target, spinners, &flock);
+
+        if (useShm) {
+            ShmFrames_publish(&shm);
+        }
+
+        unsigned long long now = Host_micros();
+        FrameTimes_add(&frameTimes, (unsigned long) (now - prev));
+        prev = now;
+        frames++;
+    }
+
+    unsigned long long elapsed = Host_micros() - start;
+    Profiler_close(&profiler);
+    FrameTimes_sort(&frameTimes);
+    printf("%lu frames, %d insects, %lu fps, frame time p50 %luus p99 %luus (last %d frames)\n",
+           frames, numInsects, elapsed ? (unsigned long) (frames * 1000000ull / elapsed) : 0,
+           FrameTimes_percentile(&frameTimes, 50), FrameTimes_percentile(&frameTimes, 99), frameTimes.count);
+
+    if (vblank.open) {
+        VBlank_close(&vblank);
+        VBlank_print(&vblank);
+    }
+
+    ShmFrames_close(&shm);
+    Mem_free(localBuffer);
+    FrameTimes_free(&frameTimes);
+    Flock_free(&flock);
+    Mem_printUsage();
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../common/platform.h"
+#include "../common/memory.h"
+#include "../common/kernels.h"
+#include "../common/points3d.h"
+
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 256
+#define DEFAULT_POINTS 4096
+#define DEFAULT_FRAMES 2000
+#define STAR_RANGE 2048
+#define NEAR_Z 16
+#define FRAME_MICROS 20000
+
+//
+// Headless benchmark of the common/points3d.h engine: a rotating starfield transformed, depth sorted and
+// plotted into an 8 bit chunky buffer through the common/kernels.h pixel kernel, as fast as possible.
+// Build with:
+//
+//   gcc -O2 host/starfield.c -lm -o build/host-starfield
+//
+// host-starfield [-points <n>] [-frames <n>] [-nosort]
+//
+// Prints the time per frame of each stage and how many points would fit in a 50 Hz frame at that rate.
+// cybergraphx/starfield.c is the same loop on an RTG screen.
+//
+
+static unsigned long long Host_micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int main(int argc, char** argv) {
+    int numPoints = DEFAULT_POINTS;
+    unsigned long numFrames = DEFAULT_FRAMES;
+    int sort = TRUE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-points") == 0 && i + 1 < argc) {
+            numPoints = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            numFrames = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-nosort") == 0) {
+            sort = FALSE;
+        }
+    }
+
+    static Points3D points;
+    static unsigned char shades[16];
+    unsigned char* buffer = Mem_alloc(SCREEN_WIDTH * SCREEN_HEIGHT, MEM_FOR_DISPLAY, TRUE);
+
+    if (!buffer || !Points3D_init(&points, numPoints, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH / 2, NEAR_Z,
+                                  STAR_RANGE * 2 + NEAR_Z)) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    KernelTarget target = {buffer, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH, 8};
+    const Kernels* kernels = Kernels_select(&target);
+
+    for (int i = 0; i < 16; i++) {
+        shades[i] = (unsigned char) (16 - i);
+    }
+    Points3D_setShades(&points, shades, 16, STAR_RANGE * 2);
+    points.cameraZ = STAR_RANGE + NEAR_Z;
+
+    srand(4);
+    for (int i = 0; i < numPoints; i++) {
+        Points3D_add(&points, rand() % (STAR_RANGE * 2) - STAR_RANGE, rand() % (STAR_RANGE * 2) - STAR_RANGE,
+                     rand() % (STAR_RANGE * 2) - STAR_RANGE);
+    }
+    numPoints = points.count;
+
+    unsigned long long transformMicros = 0, sortMicros = 0, drawMicros = 0;
+    unsigned long visible = 0;
+    unsigned long long start = Host_micros();
+
+    for (unsigned long frame = 0; frame < numFrames; frame++) {
+        unsigned long long t0 = Host_micros();
+        Points3D_scroll(&points, -8, STAR_RANGE);
+        Points3D_setRotation(&points, (int) (frame >> 2), (int) (frame >> 3), (int) frame);
+        visible += Points3D_transform(&points);
+        unsigned long long t1 = Host_micros();
+        if (sort) {
+            Points3D_sort(&points);
+        }
+        unsigned long long t2 = Host_micros();
+        kernels->clear(&target, 0);
+        Points3D_draw(&points, kernels, &target);
+        unsigned long long t3 = Host_micros();
+
+        transformMicros += t1 - t0;
+        sortMicros += t2 - t1;
+        drawMicros += t3 - t2;
+    }
+
+    unsigned long long elapsed = Host_micros() - start;
+    unsigned long long work = transformMicros + sortMicros + drawMicros;
+
+    printf("%lu frames, %d points, %lu visible per frame, kernels %s%s\n", numFrames, numPoints,
+           numFrames ? visible / numFrames : 0, kernels->name, sort ? "" : ", unsorted");
+    if (numFrames && work) {
+        printf("per frame: transform %.1f us, sort %.1f us, clear + draw %.1f us, total %.1f us\n",
+               (double) transformMicros / numFrames, (double) sortMicros / numFrames,
+               (double) drawMicros / numFrames, (double) elapsed / numFrames);
+        printf("%llu points per 50 Hz frame (transform + sort + draw)\n",
+               (unsigned long long) numPoints * numFrames * FRAME_MICROS / work);
+    }
+
+    Points3D_free(&points);
+    Mem_free(buffer);
+    Mem_printUsage();
+    return 0;
+}
@@ -9,9 +9,20 @@
 #include <clib/graphics_protos.h>
 #include <clib/exec_protos.h>
 
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/arena.h"
+#include "../common/memory.h"
+#include "../common/palette.h"
+#include "../common/counters.h"
+
 #define KC_ESC 0x45
 #define SCREEN_HEIGHT 240
 #define SCREEN_WIDTH 320
+#define NUM_INSECTS 30
+
+/* Per-frame scratch memory, split in two halves - see common/arena.h */
+#define FRAME_ARENA_SIZE (8 * 1024)
 
 typedef unsigned char u8;
 
@@ -35,10 +46,18 @@ typedef unsigned char u8;
  */
 static struct IntuitionBase* IntuitionBase;
 static struct GfxBase* GfxBase;
+struct Device* TimerBase;
 
 static struct Screen* aosScreen;
 static struct Window* aosWindow;
 
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
 /* Alternating Screen buffer and off-screen buffer */
 static struct ScreenBuffer* aosScreenBuffer[2];
 
@@ -46,6 +65,10 @@ static struct ScreenBuffer* aosScreenBuffer[2];
 static struct MsgPort* aosDpDispPort;
 static struct MsgPort* aosDpSafePort;
 
+/* Backing memory for the per-frame arena, allocated once at startup */
+static void* aosFrameArenaMem;
+static FrameArena frameArena;
+
 /* Empty pointer / hide pointer graphic */
 static UWORD nullPointerGraphic[] = {
         0x0000, 0x0000, /* reserved, must be NULL */
@@ -64,24 +87,37 @@ typedef struct sInsect {
     int c;
 } Insect;
 
-static long fcos[256];
-static long fsin[256];
+typedef struct sDrawPoint {
+    short x;
+    short y;
+} DrawPoint;
 
-static short colours[2] = {
-    0x0000, 0x0f0f
+/* Lookup tables are only read by the CPU, keep them out of Chip RAM */
+static long* fcos;
+static long* fsin;
+
+static unsigned long colours[2] = {
+    0x000000, 0xff00ff
 };
 
+/* Fade in from black over the first frames, see common/palette.h */
+#define FADE_IN_FRAMES 50
+
+static Palette palette;
+
 void AOS_DrawPixel(struct RastPort* rastPort, int x, int y) {
-    SetAPen(rastPort, 1L);
-    WritePixel(rastPort, x, y);
+    Counters_SetAPen(rastPort, 1L);
+    Counters_WritePixel(rastPort, x, y);
 }
 
 void AOS_clr(struct RastPort* rastPort) {
-    SetAPen(rastPort, 0L);
-    RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+    Counters_SetAPen(rastPort, 0L);
+    Counters_RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
 }
 
 void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
     if (aosWindow) {
         ClearPointer(aosWindow);
         CloseWindow(aosWindow);
@@ -115,6 +151,22 @@ void AOS_cleanupAndExit(int exitCode) {
         aosScreen = 0;
     }
 
+    if (aosFrameArenaMem) {
+        printf("frame arena high water: %lu of %lu bytes per frame, %lu failed allocs\n",
+               frameArena.highWater, frameArena.size, frameArena.failed);
+        Mem_free(aosFrameArenaMem);
+        aosFrameArenaMem = 0;
+    }
+
+    Palette_free(&palette);
+
+    Mem_free(fcos);
+    fcos = 0;
+    Mem_free(fsin);
+    fsin = 0;
+    Counters_print();
+    Mem_printUsage();
+
     if (IntuitionBase) {
         CloseLibrary((struct Library*) IntuitionBase);
     }
@@ -131,10 +183,21 @@ void AOS_init() {
         AOS_cleanupAndExit(0);
     }
 
-    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 0))) {
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(fcos = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE)) ||
+        !(fsin = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(aosFrameArenaMem = Mem_alloc(FRAME_ARENA_SIZE, MEM_FOR_CPU, FALSE))) {
         AOS_cleanupAndExit(0);
     }
 
+    FrameArena_init(&frameArena, aosFrameArenaMem, FRAME_ARENA_SIZE);
+
     aosScreen = OpenScreenTags(NULL,
                                SA_Depth, 1,
                                SA_Width, SCREEN_WIDTH,
@@ -151,7 +214,12 @@ void AOS_init() {
         AOS_cleanupAndExit(0);
     }
 
-    LoadRGB4(&aosScreen->ViewPort, colours, 2);
+    if (!Palette_init(&palette, 2) || !Palette_buildFade(&palette, colours, NULL, FADE_IN_FRAMES)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Palette_fadeTo(&palette, FADE_IN_FRAMES);
+    Palette_upload(&palette, &aosScreen->ViewPort);
 
     aosWindow = OpenWindowTags(NULL,
                                WA_Left, 0,
@@ -176,6 +244,8 @@ void AOS_init() {
         AOS_cleanupAndExit(0);
     }
 
+    Input_attach(&aosInput, aosWindow);
+
     SetPointer(aosWindow, nullPointerGraphic, 1, 16, 0, 0);
 
     aosDpDispPort = CreateMsgPort();
@@ -248,47 +318,55 @@ void buildLookups() {
 }
 
 static int AOS_processEvents() {
-    struct IntuiMessage* msg;
     int close = FALSE;
 
-    while ((msg = (struct IntuiMessage*) GetMsg(aosWindow->UserPort))) {
-        switch (msg->Class) {
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
             case IDCMP_CLOSEWINDOW:
                 close = TRUE;
                 break;
             case IDCMP_RAWKEY: {
-                WORD code = msg->Code & ~IECODE_UP_PREFIX;
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
                 if (code == KC_ESC) {
                     close = TRUE;
                 }
                 break;
             }
             case IDCMP_MOUSEBUTTONS: {
-                WORD code = msg->Code;
+                WORD code = msg->code;
                 if (code == SELECTDOWN) {
                     close = TRUE;
                 }
                 break;
             }
         }
-        ReplyMsg((struct Message*) msg);
     }
 
-    return !close;
+    return !close && !aosReplay.finished;
 }
 
 int main(int argc, char** argv) {
     struct RastPort rastPort;
-    Insect insect[30];
+    Insect insect[NUM_INSECTS];
 
     u8 dbSafeToChange = TRUE;
     u8 dbSafeToWrite = TRUE;
     u8 dbCurBuffer = 1;
 
     AOS_init();
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
     srand(4);
 
-    for (int i = 0; i < 30; i++) {
+    for (int i = 0; i < NUM_INSECTS; i++) {
         initInsect(&insect[i]);
     }
 
@@ -297,6 +375,20 @@ int main(int argc, char** argv) {
     InitRastPort(&rastPort);
 
     while (AOS_processEvents()) {
+        FrameArena_nextFrame(&frameArena);
+
+        /* Move everything first and gather this frame's draw list, so the drawing below is one tight loop */
+        DrawPoint* points = FrameArena_new(&frameArena, DrawPoint, NUM_INSECTS);
+        int numPoints = 0;
+        for (int j = 0; j < NUM_INSECTS; j++) {
+            moveInsect(&insect[j]);
+            if (points) {
+                points[numPoints].x = insect[j].x >> 16;
+                points[numPoints].y = insect[j].y >> 16;
+                numPoints++;
+            }
+        }
+
         /* Wait for off-screen bitmap to be writable */
         if (!dbSafeToWrite) {
             while (!GetMsg(aosDpSafePort)) {
@@ -308,12 +400,14 @@ int main(int argc, char** argv) {
         rastPort.BitMap = aosScreenBuffer[dbCurBuffer]->sb_BitMap;
 
         AOS_clr(&rastPort);
-        for (int j = 0; j < 30; j++) {
-            moveInsect(&insect[j]);
-            int x = insect[j].x >> 16;
-            int y = insect[j].y >> 16;
-            AOS_DrawPixel(&rastPort, x, y);
+        for (int j = 0; j < numPoints; j++) {
+            AOS_DrawPixel(&rastPort, points[j].x, points[j].y);
+        }
+
+        if (palette.fadeStep > 0) {
+            Palette_fadeTo(&palette, palette.fadeStep - 1);
         }
+        Palette_upload(&palette, &aosScreen->ViewPort);
 
         /* Wait for on-screen bitmap to be fully displayed */
         if (!dbSafeToChange) {
@@ -323,12 +417,13 @@ int main(int argc, char** argv) {
             dbSafeToChange = TRUE;
         }
 
-        if (ChangeScreenBuffer(aosScreen, aosScreenBuffer[dbCurBuffer])) {
+        if (Counters_ChangeScreenBuffer(aosScreen, aosScreenBuffer[dbCurBuffer])) {
             dbSafeToChange = FALSE;
             dbSafeToWrite = FALSE;
             /* toggle current buffer */
             dbCurBuffer ^=1;
         }
+        Counters_endFrame();
     }
 
     /* cleanup for pending messages */
@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <devices/timer.h>
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+#include <clib/timer_protos.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/flock.h"
+#include "../common/counters.h"
+#include "../common/frametime.h"
+#include "../common/governor.h"
+#include "../common/hud.h"
+#include "../common/startup.h"
+#include "../common/profiler.h"
+
+#define KC_ESC 0x45
+#define SCREEN_HEIGHT 256
+#define SCREEN_WIDTH 320
+#define DEFAULT_INSECTS 200
+#define NEIGHBOUR_RADIUS 16
+#define DEFAULT_BUDGET 18000
+#define PROFILE_SAMPLES 20000
+
+/* Governor levels: eighths of the insects up to level 7, then the HUD, then full screen clears */
+#define LEVEL_HUD 8
+#define LEVEL_FULL_CLEAR 9
+#define MAX_LEVEL 9
+
+//
+// Flocking insects on a 1 bit screen.  Each insect steers by the ones around it (separation, alignment,
+// cohesion), found through a uniform grid rebuilt every frame, so the cost grows with the number of insects
+// rather than its square.  See common/grid.h and common/flock.h.
+//
+// '-insects <n>' sets how many, the average update time is printed on exit.
+//
+// A governor (common/governor.h) keeps the work per frame under '-budget <us>' (18000 by default) so the
+// insects move every frame on anything from a 68000 up: over budget it first erases only last frame's insects
+// instead of clearing the whole screen, then drops the HUD, then draws fewer insects, and steps back up when
+// there's time to spare.  '-fixed' turns it off.
+//
+// '-profile <file>' samples where the time goes (common/profiler.h, '-profinterval <us>' to change the rate),
+// add it up per function with tools/profmap.
+//
+
+typedef unsigned char u8;
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+static struct IORequest TimerDevice;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static Profiler aosProfiler;
+
+static UWORD nullPointerGraphic[] = {
+        0x0000, 0x0000, /* reserved, must be NULL */
+        0x0000, 0x0000, /* 1 row of image data */
+        0x0000, 0x0000  /* reserved, must be NULL */
+};
+
+static short colours[2] = {
+    0x0000, 0x0ff0
+};
+
+static Flock flock;
+static int totalInsects;
+
+/* Byte offsets in plane 0 of the insects drawn last frame, for erasing them in dirty mode */
+static UWORD* drawnOffsets;
+static int numDrawn = 0;
+
+static FrameTimes workTimes;
+static Governor governor;
+static int governed = TRUE;
+static int dirtyMode = FALSE;
+static int fullClearNext = TRUE;
+
+static HudFont hudFont;
+static HudText hudText;
+static int hudReady = FALSE;
+static int hudOn = TRUE;
+
+static unsigned long frames = 0;
+static unsigned long neighbours = 0;
+static unsigned long candidates = 0;
+static clock_t updateClocks = 0;
+
+void AOS_clr(struct RastPort* rastPort) {
+    Counters_SetAPen(rastPort, 0L);
+    Counters_RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+}
+
+/* Microseconds of EClock ticks */
+static unsigned long AOS_micros(unsigned long long ticks, unsigned long ticksPerSecond) {
+    return (unsigned long) (ticks * 1000000 / ticksPerSecond);
+}
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+    Profiler_close(&aosProfiler);
+
+    if (frames) {
+        printf("%d insects, %lu frames: update %lu us/frame, %lu neighbours, %lu grid candidates per frame\n",
+               totalInsects, frames, (unsigned long) (updateClocks * (1000000 / CLOCKS_PER_SEC) / frames),
+               neighbours / frames, candidates / frames);
+        FrameTimes_sort(&workTimes);
+        printf("work per frame p50 %lu us, p99 %lu us\n", FrameTimes_percentile(&workTimes, 50),
+               FrameTimes_percentile(&workTimes, 99));
+        if (governed) {
+            Governor_print(&governor);
+        }
+    }
+
+    if (aosWindow) {
+        ClearPointer(aosWindow);
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosScreen) {
+        CloseScreen(aosScreen);
+        aosScreen = 0;
+    }
+
+    Flock_free(&flock);
+    Mem_free(drawnOffsets);
+    drawnOffsets = 0;
+    FrameTimes_free(&workTimes);
+    Counters_print();
+    Mem_printUsage();
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    if (TimerDevice.io_Device) {
+        CloseDevice(&TimerDevice);
+    }
+
+    exit(exitCode);
+}
+
+void AOS_init(int numInsects) {
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 0))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (OpenDevice((CONST_STRPTR)"timer.device", UNIT_MICROHZ, &TimerDevice, 0) != 0) {
+        TimerDevice.io_Device = NULL;
+        AOS_cleanupAndExit(0);
+    }
+    TimerBase = TimerDevice.io_Device;
+
+    if (!Flock_init(&flock, numInsects, SCREEN_WIDTH, SCREEN_HEIGHT, NEIGHBOUR_RADIUS) ||
+        !(drawnOffsets = Mem_alloc(numInsects * sizeof(UWORD), MEM_FOR_CPU, FALSE)) ||
+        !FrameTimes_init(&workTimes, 256)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosScreen = OpenScreenTags(NULL,
+                               SA_Depth, 1,
+                               SA_Width, SCREEN_WIDTH,
+                               SA_Height, SCREEN_HEIGHT,
+                               SA_Type, CUSTOMSCREEN,
+                               SA_Quiet, TRUE,
+                               SA_ShowTitle, FALSE,
+                               SA_Draggable, FALSE,
+                               SA_Exclusive, TRUE,
+                               SA_AutoScroll, FALSE,
+                               TAG_END);
+
+    if (aosScreen == NULL) {
+        AOS_cleanupAndExit(0);
+    }
+
+    LoadRGB4(&aosScreen->ViewPort, colours, 2L);
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 0,
+                               WA_Top, 0,
+                               WA_Width, SCREEN_WIDTH,
+                               WA_Height, SCREEN_HEIGHT,
+                               WA_CustomScreen, aosScreen,
+                               WA_Title, NULL,
+                               WA_Backdrop, TRUE,
+                               WA_Borderless, TRUE,
+                               WA_DragBar, FALSE,
+                               WA_Activate, TRUE,
+                               WA_SmartRefresh, TRUE,
+                               WA_NoCareRefresh, TRUE,
+                               WA_Activate, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_ReportMouse, TRUE,
+                               WA_IDCMP, IDCMP_RAWKEY | IDCMP_MOUSEMOVE | IDCMP_MOUSEBUTTONS | IDCMP_ACTIVEWINDOW,
+                               TAG_DONE);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Input_attach(&aosInput, aosWindow);
+
+    SetPointer(aosWindow, nullPointerGraphic, 1, 16, 0, 0);
+
+    if ((hudReady = Hud_initFont(&hudFont, &aosScreen->RastPort, "0123456789 insects"))) {
+        HudText_init(&hudText, &hudFont, 4, 4 + hudFont.baseline, 1, 0, " insects");
+    }
+}
+
+void initInsects(int numInsects) {
+    for (int i = 0; i < numInsects; i++) {
+        double angle = (rand() % 256) * M_PI * 2 / 256;
+        Flock_add(&flock, (long) (rand() % SCREEN_WIDTH) << 16, (long) (rand() % SCREEN_HEIGHT) << 16,
+                  (long) (2 * 65536 * cos(angle)), (long) (2 * 65536 * sin(angle)));
+    }
+}
+
+/* Set the workload for governor 'level' */
+void applyLevel(int level) {
+    int eighths = level + 1 < 8 ? level + 1 : 8;
+    int active = totalInsects * eighths / 8;
+    int hud = level >= LEVEL_HUD;
+    int dirty = level < LEVEL_FULL_CLEAR;
+
+    if (active < 1) {
+        active = 1;
+    }
+
+    /* Insects left out keep their place in the flock and carry on from there when they come back */
+    flock.count = active;
+
+    /* The HUD is only ever drawn over, so clear it away properly when it goes */
+    if (hudOn && !hud) {
+        fullClearNext = TRUE;
+    }
+    hudOn = hud;
+    dirtyMode = dirty;
+}
+
+/* Erase last frame, either the whole screen with the blitter or just the bytes the insects were drawn into */
+void clearFrame(struct BitMap* bitMap) {
+    if (!dirtyMode || fullClearNext) {
+        AOS_clr(&aosScreen->RastPort);
+        WaitBlit();
+        fullClearNext = FALSE;
+        return;
+    }
+
+    u8* plane = bitMap->Planes[0];
+    for (int i = 0; i < numDrawn; i++) {
+        plane[drawnOffsets[i]] = 0;
+    }
+    Counters_bytes(numDrawn);
+}
+
+/* The HUD only draws over its current width, clear what a longer count left to the right of it */
+void clearHudTail(struct BitMap* bitMap, int oldWidth) {
+    int left = hudText.x + hudText.width;
+    int right = hudText.x + oldWidth < SCREEN_WIDTH ? hudText.x + oldWidth : SCREEN_WIDTH;
+
+    for (int y = hudText.y; y < hudText.y + hudFont.height; y++) {
+        if (y < 0 || y >= SCREEN_HEIGHT) {
+            continue;
+        }
+        u8* row = bitMap->Planes[0] + y * bitMap->BytesPerRow;
+        for (int x = left; x < right; x++) {
+            row[x >> 3] &= ~(0x80 >> (x & 7));
+        }
+    }
+}
+
+void drawInsects(struct BitMap* bitMap) {
+    u8* plane = bitMap->Planes[0];
+    int bytesPerRow = bitMap->BytesPerRow;
+
+    /* Set one pixel per insect straight into the bitplane */
+    for (int i = 0; i < flock.count; i++) {
+        int x = flock.x[i] >> 16;
+        int y = flock.y[i] >> 16;
+        UWORD offset = (UWORD) (y * bytesPerRow + (x >> 3));
+        plane[offset] |= 0x80 >> (x & 7);
+        drawnOffsets[i] = offset;
+    }
+    numDrawn = flock.count;
+    Counters_pixels(flock.count);
+    Counters_bytes(flock.count);
+
+    if (hudReady && hudOn) {
+        int oldWidth = hudText.width;
+        HudText_setNumber(&hudText, &hudFont, flock.count);
+        if (hudText.width < oldWidth) {
+            clearHudTail(bitMap, oldWidth);
+        }
+        Hud_drawPlanar(&hudFont, &hudText, bitMap->Planes, 1, bytesPerRow, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+}
+
+/* Process any pending events */
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    /* Escape, left mouse and close window message exit */
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_CLOSEWINDOW:
+                // Window close button is hidden so we shouldn't get this message
+                close = TRUE;
+                break;
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
+                // escape key exits
+                if (code == KC_ESC) {
+                    close = TRUE;
+                }
+                break;
+            }
+            case IDCMP_MOUSEBUTTONS: {
+                WORD code = msg->code;
+                // left mouse exits
+                if (code == SELECTDOWN) {
+                    close = TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+int main(int argc, char** argv) {
+    int numInsects = DEFAULT_INSECTS;
+    unsigned long budget = DEFAULT_BUDGET;
+    const char* profilePath = NULL;
+    unsigned long profileInterval = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-insects") == 0 && i + 1 < argc) {
+            numInsects = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc) {
+            budget = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-fixed") == 0) {
+            governed = FALSE;
+        } else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (strcmp(argv[i], "-profinterval") == 0 && i + 1 < argc) {
+            profileInterval = strtoul(argv[++i], NULL, 0);
+        }
+    }
+
+    if (numInsects < 1) {
+        numInsects = 1;
+    }
+
+    AOS_init(numInsects);
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    srand(4);
+
+    initInsects(numInsects);
+    totalInsects = numInsects;
+
+    Governor_init(&governor, budget, MAX_LEVEL);
+    applyLevel(governor.level);
+
+    struct BitMap* bitMap = aosScreen->RastPort.BitMap;
+    unsigned long ticksPerSecond;
+
+    if (profilePath && !Profiler_open(&aosProfiler, profilePath, profileInterval, PROFILE_SAMPLES,
+                                      (void (*)()) main)) {
+        printf("Can't start the profiler\n");
+    }
+
+    while (AOS_processEvents()) {
+        unsigned long long workStart = Startup_now(&ticksPerSecond);
+        clock_t start = clock();
+        Flock_update(&flock);
+        updateClocks += clock() - start;
+        unsigned long long work = Startup_now(&ticksPerSecond) - workStart;
+
+        neighbours += flock.neighbours;
+        candidates += flock.grid.candidates;
+        frames++;
+
+        WaitTOF();
+        workStart = Startup_now(&ticksPerSecond);
+        clearFrame(bitMap);
+        drawInsects(bitMap);
+        work += Startup_now(&ticksPerSecond) - workStart;
+        Counters_endFrame();
+
+        /* Only the work counts towards the budget, not waiting for the display */
+        FrameTimes_add(&workTimes, AOS_micros(work, ticksPerSecond));
+        if (governed) {
+            int level = governor.level;
+            if (Governor_update(&governor, &workTimes) != level) {
+                applyLevel(governor.level);
+            }
+        }
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}
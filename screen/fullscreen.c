@@ -9,6 +9,12 @@
 #include <clib/graphics_protos.h>
 #include <clib/exec_protos.h>
 
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/copper.h"
+#include "../common/counters.h"
+
 #define KC_ESC 0x45
 #define SCREEN_HEIGHT 256
 #define SCREEN_WIDTH 320
@@ -18,15 +24,26 @@
 // Use the raster to draw to the screens bitmap like good amigos.
 // No delay between frames - i.e. draw as fast as possible.
 //
+// The background and insect colours are changed per scanline by a user copper list, built once at startup
+// so they cost nothing per frame.
+//
 
 typedef unsigned char u8;
 
 static struct IntuitionBase* IntuitionBase;
 static struct GfxBase* GfxBase;
+struct Device* TimerBase;
 
 static struct Screen* aosScreen;
 static struct Window* aosWindow;
 
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
 static UWORD nullPointerGraphic[] = {
         0x0000, 0x0000, /* reserved, must be NULL */
         0x0000, 0x0000, /* 1 row of image data */
@@ -44,24 +61,29 @@ typedef struct sInsect {
     int c;
 } Insect;
 
-static long fcos[256];
-static long fsin[256];
+/* Lookup tables are only read by the CPU, keep them out of Chip RAM */
+static long* fcos;
+static long* fsin;
 
 static short colours[2] = {
     0x0000, 0x0f0f
 };
 
+static CopperFx copperFx;
+
 void AOS_DrawPixel(struct RastPort* rastPort, int x, int y) {
-    SetAPen(rastPort, 1L);
-    WritePixel(rastPort, x, y);
+    Counters_SetAPen(rastPort, 1L);
+    Counters_WritePixel(rastPort, x, y);
 }
 
 void AOS_clr(struct RastPort* rastPort) {
-    SetAPen(rastPort, 0L);
-    RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+    Counters_SetAPen(rastPort, 0L);
+    Counters_RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
 }
 
 void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
     if (aosWindow) {
         ClearPointer(aosWindow);
         CloseWindow(aosWindow);
@@ -73,6 +95,18 @@ void AOS_cleanupAndExit(int exitCode) {
         aosScreen = 0;
     }
 
+    if (copperFx.changes) {
+        printf("copper list rebuilds: %d\n", copperFx.rebuilds);
+        CopperFx_free(&copperFx);
+    }
+
+    Mem_free(fcos);
+    fcos = 0;
+    Mem_free(fsin);
+    fsin = 0;
+    Counters_print();
+    Mem_printUsage();
+
     if (IntuitionBase) {
         CloseLibrary((struct Library*) IntuitionBase);
     }
@@ -93,6 +127,11 @@ void AOS_init() {
         AOS_cleanupAndExit(0);
     }
 
+    if (!(fcos = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE)) ||
+        !(fsin = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE))) {
+        AOS_cleanupAndExit(0);
+    }
+
     aosScreen = OpenScreenTags(NULL,
                                SA_Depth, 1,
                                SA_Width, SCREEN_WIDTH,
@@ -111,6 +150,15 @@ void AOS_init() {
 
     LoadRGB4(&aosScreen->ViewPort, colours, 2L);
 
+    if (!CopperFx_init(&copperFx, aosScreen, SCREEN_HEIGHT, 128)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    /* Dark blue sky fading to black for the background, insects go from yellow to magenta down the screen */
+    CopperFx_gradient(&copperFx, 0, SCREEN_HEIGHT / 2, 0, 0x0008, 0x0000);
+    CopperFx_gradient(&copperFx, 0, SCREEN_HEIGHT - 1, 1, 0x0ff0, 0x0f0f);
+    CopperFx_commit(&copperFx);
+
     aosWindow = OpenWindowTags(NULL,
                                WA_Left, 0,
                                WA_Top, 0,
@@ -133,6 +181,8 @@ void AOS_init() {
     if (!aosWindow) {
         AOS_cleanupAndExit(0);
     }
+
+    Input_attach(&aosInput, aosWindow);
 }
 
 void moveInsect(Insect* insect) {
@@ -194,18 +244,22 @@ void buildLookups() {
 
 /* Process any pending events */
 static int AOS_processEvents() {
-    struct IntuiMessage* msg;
     int close = FALSE;
 
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
     /* Escape, left mouse and close window message exit */
-    while ((msg = (struct IntuiMessage*) GetMsg(aosWindow->UserPort))) {
-        switch (msg->Class) {
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
             case IDCMP_CLOSEWINDOW:
                 // Window close button is hidden so we shouldn't get this message
                 close = TRUE;
                 break;
             case IDCMP_RAWKEY: {
-                WORD code = msg->Code & ~IECODE_UP_PREFIX;
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
                 // escape key exits
                 if (code == KC_ESC) {
                     close = TRUE;
@@ -213,7 +267,7 @@ static int AOS_processEvents() {
                 break;
             }
             case IDCMP_MOUSEBUTTONS: {
-                WORD code = msg->Code;
+                WORD code = msg->code;
                 // left mouse exits
                 if (code == SELECTDOWN) {
                     close = TRUE;
@@ -221,10 +275,9 @@ static int AOS_processEvents() {
                 break;
             }
         }
-        ReplyMsg((struct Message*) msg);
     }
 
-    return !close;
+    return !close && !aosReplay.finished;
 }
 
 int main(int argc, char** argv) {
@@ -235,6 +288,11 @@ int main(int argc, char** argv) {
     u8 dbCurBuffer = 1;
 
     AOS_init();
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
     srand(4);
 
     for (int i = 0; i < 30; i++) {
@@ -251,6 +309,7 @@ int main(int argc, char** argv) {
             int y = insect[j].y >> 16;
             AOS_DrawPixel(&aosScreen->RastPort, x, y);
         }
+        Counters_endFrame();
     }
 
     AOS_cleanupAndExit(0);
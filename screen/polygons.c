@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <graphics/gfxmacros.h>
+#include <graphics/rastport.h>
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/raster.h"
+
+#define KC_ESC 0x45
+#define SCREEN_HEIGHT 256
+#define SCREEN_WIDTH 320
+#define SCREEN_DEPTH 3
+#define NUM_POLYGONS 24
+#define MAX_VERTICES 6
+
+//
+// Spinning flat shaded polygons on a 3 bitplane screen, filled by the span rasterizer in common/raster.h
+// writing straight into the bitplanes, or with '-areafill' by graphics.library AreaMove / AreaDraw / AreaEnd.
+// AreaFill goes through the window's RastPort, whose layer clips the polygons hanging off the screen edges.
+//
+// '-bench <frames>' draws the same polygons for <frames> frames with each and prints polygons/s for both.
+// Pixels/s is only printed for the span rasterizer, which counts what it fills; AreaFill doesn't say.
+//
+
+typedef unsigned char u8;
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static UWORD nullPointerGraphic[] = {
+        0x0000, 0x0000, /* reserved, must be NULL */
+        0x0000, 0x0000, /* 1 row of image data */
+        0x0000, 0x0000  /* reserved, must be NULL */
+};
+
+static short colours[8] = {
+    0x0000, 0x0f00, 0x00f0, 0x000f, 0x0ff0, 0x0f0f, 0x00ff, 0x0fff
+};
+
+typedef struct sPolygon {
+    short cx;
+    short cy;
+    short radius;
+    unsigned char numVertices;
+    unsigned char angle;
+    char spin;
+    char colour;
+} Polygon;
+
+/* Lookup tables are only read by the CPU, keep them out of Chip RAM */
+static long* fcos;
+static long* fsin;
+
+static RasterTarget rasterTarget;
+
+/* AreaFill() needs a vector buffer and a TmpRas the size of the window */
+static struct AreaInfo areaInfo;
+static struct TmpRas tmpRas;
+static WORD areaBuffer[(MAX_VERTICES + 1) * 5 / 2 + 1];
+static PLANEPTR tmpRasPlane;
+
+void AOS_clr(struct RastPort* rastPort) {
+    SetAPen(rastPort, 0L);
+    RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+}
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
+    if (aosWindow) {
+        aosWindow->RPort->AreaInfo = NULL;
+        aosWindow->RPort->TmpRas = NULL;
+    }
+
+    if (tmpRasPlane) {
+        FreeRaster(tmpRasPlane, SCREEN_WIDTH, SCREEN_HEIGHT);
+        tmpRasPlane = 0;
+    }
+
+    if (aosWindow) {
+        ClearPointer(aosWindow);
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosScreen) {
+        CloseScreen(aosScreen);
+        aosScreen = 0;
+    }
+
+    Mem_free(fcos);
+    fcos = 0;
+    Mem_free(fsin);
+    fsin = 0;
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    exit(exitCode);
+}
+
+void AOS_init() {
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 0))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(fcos = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE)) ||
+        !(fsin = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosScreen = OpenScreenTags(NULL,
+                               SA_Depth, SCREEN_DEPTH,
+                               SA_Width, SCREEN_WIDTH,
+                               SA_Height, SCREEN_HEIGHT,
+                               SA_Type, CUSTOMSCREEN,
+                               SA_Quiet, TRUE,
+                               SA_ShowTitle, FALSE,
+                               SA_Draggable, FALSE,
+                               SA_Exclusive, TRUE,
+                               SA_AutoScroll, FALSE,
+                               TAG_END);
+
+    if (aosScreen == NULL) {
+        AOS_cleanupAndExit(0);
+    }
+
+    LoadRGB4(&aosScreen->ViewPort, colours, 8L);
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 0,
+                               WA_Top, 0,
+                               WA_Width, SCREEN_WIDTH,
+                               WA_Height, SCREEN_HEIGHT,
+                               WA_CustomScreen, aosScreen,
+                               WA_Title, NULL,
+                               WA_Backdrop, TRUE,
+                               WA_Borderless, TRUE,
+                               WA_DragBar, FALSE,
+                               WA_Activate, TRUE,
+                               WA_SmartRefresh, TRUE,
+                               WA_NoCareRefresh, TRUE,
+                               WA_Activate, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_ReportMouse, TRUE,
+                               WA_IDCMP, IDCMP_RAWKEY | IDCMP_MOUSEMOVE | IDCMP_MOUSEBUTTONS | IDCMP_ACTIVEWINDOW,
+                               TAG_DONE);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(tmpRasPlane = AllocRaster(SCREEN_WIDTH, SCREEN_HEIGHT))) {
+        AOS_cleanupAndExit(0);
+    }
+    InitTmpRas(&tmpRas, tmpRasPlane, RASSIZE(SCREEN_WIDTH, SCREEN_HEIGHT));
+    InitArea(&areaInfo, areaBuffer, MAX_VERTICES + 1);
+    aosWindow->RPort->AreaInfo = &areaInfo;
+    aosWindow->RPort->TmpRas = &tmpRas;
+
+    Input_attach(&aosInput, aosWindow);
+
+    SetPointer(aosWindow, nullPointerGraphic, 1, 16, 0, 0);
+
+    struct BitMap* bitMap = aosScreen->RastPort.BitMap;
+    Raster_initPlanar(&rasterTarget, bitMap->Planes, SCREEN_DEPTH, bitMap->BytesPerRow,
+                      SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+void buildLookups() {
+    int i;
+    for (i = 0; i < 256; i++) {
+        fsin[i] = 65536 * sin(i * M_PI * 2 / 256);
+        fcos[i] = 65536 * cos(i * M_PI * 2 / 256);
+    }
+}
+
+void initPolygons(Polygon* polygons) {
+    for (int i = 0; i < NUM_POLYGONS; i++) {
+        Polygon* p = &polygons[i];
+        p->cx = rand() % SCREEN_WIDTH;
+        p->cy = rand() % SCREEN_HEIGHT;
+        p->radius = rand() % 40 + 10;
+        p->numVertices = rand() % (MAX_VERTICES - 2) + 3;
+        p->angle = rand() % 256;
+        p->spin = rand() % 7 - 3;
+        p->colour = i % 7 + 1;
+    }
+}
+
+/* Vertices of a regular polygon at its current angle */
+void polygonVertices(const Polygon* p, short* xs, short* ys) {
+    for (int v = 0; v < p->numVertices; v++) {
+        unsigned char a = p->angle + v * 256 / p->numVertices;
+        xs[v] = p->cx + ((p->radius * fcos[a]) >> 16);
+        ys[v] = p->cy + ((p->radius * fsin[a]) >> 16);
+    }
+}
+
+void drawPolygons(Polygon* polygons, int useAreaFill) {
+    struct RastPort* rastPort = aosWindow->RPort;
+    short xs[MAX_VERTICES];
+    short ys[MAX_VERTICES];
+
+    AOS_clr(rastPort);
+
+    if (!useAreaFill) {
+        WaitBlit();
+    }
+
+    for (int i = 0; i < NUM_POLYGONS; i++) {
+        Polygon* p = &polygons[i];
+        polygonVertices(p, xs, ys);
+        p->angle += p->spin;
+
+        if (useAreaFill) {
+            SetAPen(rastPort, p->colour);
+            AreaMove(rastPort, xs[0], ys[0]);
+            for (int v = 1; v < p->numVertices; v++) {
+                AreaDraw(rastPort, xs[v], ys[v]);
+            }
+            AreaEnd(rastPort);
+        } else {
+            Raster_polygon(&rasterTarget, xs, ys, p->numVertices, p->colour);
+        }
+    }
+}
+
+/* Process any pending events */
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    /* Escape, left mouse and close window message exit */
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_CLOSEWINDOW:
+                // Window close button is hidden so we shouldn't get this message
+                close = TRUE;
+                break;
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
+                // escape key exits
+                if (code == KC_ESC) {
+                    close = TRUE;
+                }
+                break;
+            }
+            case IDCMP_MOUSEBUTTONS: {
+                WORD code = msg->code;
+                // left mouse exits
+                if (code == SELECTDOWN) {
+                    close = TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+/* Draw 'frames' frames of the same polygons with the span rasterizer then AreaFill, print the rate of each */
+void runBench(int frames) {
+    static const char* names[2] = {"span rasterizer", "AreaFill"};
+    Polygon polygons[NUM_POLYGONS];
+
+    for (int useAreaFill = 0; useAreaFill < 2; useAreaFill++) {
+        srand(4);
+        initPolygons(polygons);
+
+        rasterTarget.pixels = 0;
+        clock_t start = clock();
+        unsigned long drawn = 0;
+
+        for (int frame = 0; frame < frames && AOS_processEvents(); frame++) {
+            drawPolygons(polygons, useAreaFill);
+            drawn += NUM_POLYGONS;
+        }
+        WaitBlit();
+
+        clock_t elapsed = clock() - start;
+        unsigned long ms = (unsigned long) (elapsed * 1000 / CLOCKS_PER_SEC);
+        if (!ms) {
+            ms = 1;
+        }
+        printf("%-16s %6lu ms %9lu polygons/s", names[useAreaFill], ms,
+               (unsigned long) ((unsigned long long) drawn * 1000 / ms));
+        if (!useAreaFill) {
+            printf(" %9lu pixels %9lu pixels/s", rasterTarget.pixels,
+                   (unsigned long) ((unsigned long long) rasterTarget.pixels * 1000 / ms));
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Polygon polygons[NUM_POLYGONS];
+    int useAreaFill = FALSE;
+    int benchFrames = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-areafill") == 0) {
+            useAreaFill = TRUE;
+        } else if (strcmp(argv[i], "-bench") == 0 && i + 1 < argc) {
+            benchFrames = atoi(argv[++i]);
+        }
+    }
+
+    AOS_init();
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    buildLookups();
+
+    if (benchFrames > 0) {
+        runBench(benchFrames);
+        AOS_cleanupAndExit(0);
+    }
+
+    srand(4);
+    initPolygons(polygons);
+
+    while (AOS_processEvents()) {
+        WaitTOF();
+        drawPolygons(polygons, useAreaFill);
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <graphics/view.h>
+#include <graphics/modeid.h>
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/palette.h"
+#include "../common/iff.h"
+
+#define KC_ESC 0x45
+
+//
+// Shows an IFF ILBM or PBM picture on a screen of its own size and depth.
+//
+// showiff [-record <file> | -replay <file>] <file>
+//
+// ILBM bodies are decoded by common/iff.h straight into the screen's bitplanes when they are standard planar
+// ones, anything else (PBM pictures, or an RTG screen) goes through one chunky row buffer and
+// WriteChunkyPixels().  The screen opens behind and comes to the front once the picture and its CMAP colours
+// are in.  The load time and rate are printed on exit.
+//
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static IffReader reader;
+static IffImage image;
+static Palette palette;
+static unsigned char* chunkyRow;
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+    Iff_close(&reader);
+
+    if (aosWindow) {
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosScreen) {
+        CloseScreen(aosScreen);
+        aosScreen = 0;
+    }
+
+    Mem_free(chunkyRow);
+    chunkyRow = 0;
+    Palette_free(&palette);
+    Mem_printUsage();
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    exit(exitCode);
+}
+
+/* The picture's own display mode from CAMG when this machine has it, otherwise a guess from its size */
+ULONG AOS_modeFor(const IffImage* iff) {
+    ULONG modes = iff->viewModes;
+
+    /* Old 16 bit CAMGs carry ViewPort flags that aren't part of a mode ID */
+    if (!(modes & MONITOR_ID_MASK) || ((modes & EXTENDED_MODE) && !(modes & 0xFFFF0000))) {
+        modes &= ~(EXTENDED_MODE | SPRITES | VP_HIDE | GENLOCK_AUDIO | GENLOCK_VIDEO);
+    }
+
+    if (modes && !ModeNotAvailable(modes)) {
+        return modes;
+    }
+
+    if (iff->width > 400) {
+        return iff->height > 300 ? HIRESLACE_KEY : HIRES_KEY;
+    }
+    return iff->height > 300 ? LORESLACE_KEY : LORES_KEY;
+}
+
+void AOS_init(const char* path) {
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 40))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!Iff_open(&reader, &image, path)) {
+        printf("Can't read %s as an ILBM or PBM picture\n", path);
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!Palette_init(&palette, 1 << image.depth) ||
+        !(chunkyRow = Mem_alloc(image.width, MEM_FOR_CPU, FALSE))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosScreen = OpenScreenTags(NULL,
+                               SA_DisplayID, AOS_modeFor(&image),
+                               SA_Depth, image.depth,
+                               SA_Width, image.width,
+                               SA_Height, image.height,
+                               SA_Type, CUSTOMSCREEN,
+                               SA_Quiet, TRUE,
+                               SA_ShowTitle, FALSE,
+                               SA_Behind, TRUE,
+                               TAG_END);
+
+    if (aosScreen == NULL) {
+        printf("Can't open a %d x %d x %d screen\n", image.width, image.height, image.depth);
+        AOS_cleanupAndExit(0);
+    }
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 0,
+                               WA_Top, 0,
+                               WA_Width, image.width,
+                               WA_Height, image.height,
+                               WA_CustomScreen, aosScreen,
+                               WA_Title, NULL,
+                               WA_Backdrop, TRUE,
+                               WA_Borderless, TRUE,
+                               WA_DragBar, FALSE,
+                               WA_Activate, TRUE,
+                               WA_SmartRefresh, TRUE,
+                               WA_NoCareRefresh, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_IDCMP, IDCMP_RAWKEY | IDCMP_MOUSEBUTTONS,
+                               TAG_DONE);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Input_attach(&aosInput, aosWindow);
+}
+
+/* Decode the BODY into the screen, returns FALSE if the file ended early */
+int loadPicture() {
+    struct BitMap* bitMap = aosScreen->RastPort.BitMap;
+
+    if (!image.chunky && (GetBitMapAttr(bitMap, BMA_FLAGS) & BMF_STANDARD)) {
+        return Iff_readPlanar(&reader, &image, bitMap->Planes, bitMap->Depth, bitMap->BytesPerRow,
+                              aosScreen->Height);
+    }
+
+    for (int y = 0; y < image.height && y < aosScreen->Height; y++) {
+        if (!Iff_readRowChunky(&reader, &image, chunkyRow, image.width)) {
+            return FALSE;
+        }
+        WriteChunkyPixels(&aosScreen->RastPort, 0, y, image.width - 1, y, chunkyRow, image.width);
+    }
+    return TRUE;
+}
+
+/* Process any pending events */
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    /* Escape or left mouse exits */
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
+                if (code == KC_ESC) {
+                    close = TRUE;
+                }
+                break;
+            }
+            case IDCMP_MOUSEBUTTONS: {
+                WORD code = msg->code;
+                if (code == SELECTDOWN) {
+                    close = TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+
+    /* The picture is the first argument that isn't an option or an option's value */
+    for (int i = 1; i < argc && !path; i++) {
+        if (strcmp(argv[i], "-record") == 0 || strcmp(argv[i], "-replay") == 0) {
+            i++;
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        printf("usage: %s [-record <file> | -replay <file>] <ILBM or PBM file>\n", argv[0]);
+        return 0;
+    }
+
+    clock_t start = clock();
+
+    AOS_init(path);
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    int complete = loadPicture();
+    Iff_close(&reader);
+
+    Iff_setPalette(&image, &palette);
+    Palette_upload(&palette, &aosScreen->ViewPort);
+    ScreenToFront(aosScreen);
+
+    unsigned long ms = (unsigned long) ((clock() - start) * 1000 / CLOCKS_PER_SEC);
+    printf("%s: %d x %d, %d %s, %s%s, loaded in %lu ms", path, image.width, image.height, image.depth,
+           image.chunky ? "bit chunky" : "planes", image.compression ? "ByteRun1" : "uncompressed",
+           complete ? "" : " (file ends early)", ms);
+    if (ms) {
+        printf(", %lu KB/s", reader.bodySize / ms);
+    }
+    printf("\n");
+
+    while (AOS_processEvents()) {
+        WaitPort(aosWindow->UserPort);
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/sprites.h"
+
+#define KC_ESC 0x45
+#define SCREEN_HEIGHT 256
+#define SCREEN_WIDTH 320
+#define NUM_INSECTS 64
+
+//
+// Same insects as fullscreen.c, but drawn with hardware sprites instead of WritePixel(), so the bitmap is
+// never cleared or written to for them.  Sprite channels are reused down the screen, insects that don't fit
+// on a free channel become BOBs with background save / restore.  See common/sprites.h.
+//
+
+typedef unsigned char u8;
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static UWORD nullPointerGraphic[] = {
+        0x0000, 0x0000, /* reserved, must be NULL */
+        0x0000, 0x0000, /* 1 row of image data */
+        0x0000, 0x0000  /* reserved, must be NULL */
+};
+
+typedef struct sInsect {
+    long dx;
+    long dy;
+    long x;
+    long y;
+    unsigned char angle;
+    unsigned char dangle;
+    int speed;
+    int c;
+} Insect;
+
+/* Lookup tables are only read by the CPU, keep them out of Chip RAM */
+static long* fcos;
+static long* fsin;
+
+static SpriteEngine spriteEngine;
+
+/* Playfield colours, then sprite colours 16-31 (pairs of channels share 4 entries, first is transparent) */
+static short colours[32] = {
+    0x0000, 0x0f0f, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0f80, 0x0ff0, 0x0fff, 0x0000, 0x08f0, 0x00f8, 0x0fff,
+    0x0000, 0x008f, 0x080f, 0x0fff, 0x0000, 0x0f08, 0x0f00, 0x0fff,
+};
+
+/* 16 pixel wide 2 bitplane sprite image, plane 0 word then plane 1 word per line */
+static UWORD insectImage[] = {
+    0x6000, 0x0000,
+    0x9000, 0x6000,
+    0x9000, 0x6000,
+    0x6000, 0x0000,
+};
+
+void AOS_clr(struct RastPort* rastPort) {
+    SetAPen(rastPort, 0L);
+    RectFill(rastPort, 0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+}
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
+    printf("last frame: %d sprites, %d bobs\n", spriteEngine.spritesShown, spriteEngine.bobsShown);
+    Sprites_free(&spriteEngine);
+
+    if (aosWindow) {
+        ClearPointer(aosWindow);
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosScreen) {
+        CloseScreen(aosScreen);
+        aosScreen = 0;
+    }
+
+    Mem_free(fcos);
+    fcos = 0;
+    Mem_free(fsin);
+    fsin = 0;
+    Mem_printUsage();
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    exit(exitCode);
+}
+
+void AOS_init() {
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 0))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(fcos = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE)) ||
+        !(fsin = Mem_alloc(256 * sizeof(long), MEM_FOR_CPU, FALSE))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosScreen = OpenScreenTags(NULL,
+                               SA_Depth, 1,
+                               SA_Width, SCREEN_WIDTH,
+                               SA_Height, SCREEN_HEIGHT,
+                               SA_Type, CUSTOMSCREEN,
+                               SA_Quiet, TRUE,
+                               SA_ShowTitle, FALSE,
+                               SA_Draggable, FALSE,
+                               SA_Exclusive, TRUE,
+                               SA_AutoScroll, FALSE,
+                               TAG_END);
+
+    if (aosScreen == NULL) {
+        AOS_cleanupAndExit(0);
+    }
+
+    LoadRGB4(&aosScreen->ViewPort, colours, 32L);
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 0,
+                               WA_Top, 0,
+                               WA_Width, SCREEN_WIDTH,
+                               WA_Height, SCREEN_HEIGHT,
+                               WA_CustomScreen, aosScreen,
+                               WA_Title, NULL,
+                               WA_Backdrop, TRUE,
+                               WA_Borderless, TRUE,
+                               WA_DragBar, FALSE,
+                               WA_Activate, TRUE,
+                               WA_SmartRefresh, TRUE,
+                               WA_NoCareRefresh, TRUE,
+                               WA_Activate, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_ReportMouse, TRUE,
+                               WA_IDCMP, IDCMP_RAWKEY | IDCMP_MOUSEMOVE | IDCMP_MOUSEBUTTONS | IDCMP_ACTIVEWINDOW,
+                               TAG_DONE);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Input_attach(&aosInput, aosWindow);
+
+    SetPointer(aosWindow, nullPointerGraphic, 1, 16, 0, 0);
+
+    if (!Sprites_init(&spriteEngine, &aosScreen->ViewPort, aosScreen->RastPort.BitMap,
+                      SCREEN_WIDTH, SCREEN_HEIGHT, insectImage, 4, NUM_INSECTS, 1)) {
+        AOS_cleanupAndExit(0);
+    }
+}
+
+void moveInsect(Insect* insect) {
+    if (insect->c <= 0) {
+        insect->c = rand() % 10 + 5;
+        insect->dangle = rand() % 10 - 5;
+    }
+
+    insect->c--;
+    insect->angle += insect->dangle;
+    insect->dx = insect->speed * fcos[insect->angle];
+    insect->dy = insect->speed * fsin[insect->angle];
+    insect->x += insect->dx;
+    insect->y += insect->dy;
+
+    if (insect->x < 0) {
+        insect->x = 0;
+        insect->angle = 128 - insect->angle;
+        insect->c = rand() % 10 + 10;
+    }
+
+    if (insect->x >= (SCREEN_WIDTH << 16)) {
+        insect->x = ((SCREEN_WIDTH - 1) << 16);
+        insect->angle = 128 - insect->angle;
+        insect->c = rand() % 10 + 10;
+    }
+
+    if (insect->y < 0) {
+        insect->y = 0;
+        insect->angle = 256 - insect->angle;
+        insect->c = rand() % 10 + 10;
+    }
+
+    if (insect->y >= (SCREEN_HEIGHT << 16)) {
+        insect->y = ((SCREEN_HEIGHT - 1) << 16);
+        insect->angle = 256 - insect->angle;
+        insect->c = rand() % 10 + 10;
+    }
+}
+
+void initInsect(Insect* i) {
+    i->dx = 0;
+    i->dy = 0;
+    i->x = (rand() % SCREEN_WIDTH << 16);
+    i->y = (rand() % SCREEN_HEIGHT << 16);
+    i->angle = 0;
+    i->dangle = 0;
+    i->speed = 3;
+    i->c = 0;
+}
+
+void buildLookups() {
+    int i;
+    for (i = 0; i < 256; i++) {
+        fsin[i] = 65536 * sin(i * M_PI * 2 / 256);
+        fcos[i] = 65536 * cos(i * M_PI * 2 / 256);
+    }
+}
+
+/* Process any pending events */
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    /* Escape, left mouse and close window message exit */
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_CLOSEWINDOW:
+                // Window close button is hidden so we shouldn't get this message
+                close = TRUE;
+                break;
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code & ~IECODE_UP_PREFIX;
+                // escape key exits
+                if (code == KC_ESC) {
+                    close = TRUE;
+                }
+                break;
+            }
+            case IDCMP_MOUSEBUTTONS: {
+                WORD code = msg->code;
+                // left mouse exits
+                if (code == SELECTDOWN) {
+                    close = TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+int main(int argc, char** argv) {
+    Insect insect[NUM_INSECTS];
+    short insectX[NUM_INSECTS];
+    short insectY[NUM_INSECTS];
+
+    AOS_init();
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    srand(4);
+
+    for (int i = 0; i < NUM_INSECTS; i++) {
+        initInsect(&insect[i]);
+    }
+
+    buildLookups();
+
+    AOS_clr(&aosScreen->RastPort);
+
+    while (AOS_processEvents()) {
+        for (int j = 0; j < NUM_INSECTS; j++) {
+            moveInsect(&insect[j]);
+            insectX[j] = insect[j].x >> 16;
+            insectY[j] = insect[j].y >> 16;
+        }
+
+        WaitTOF();
+        Sprites_update(&spriteEngine, insectX, insectY, NUM_INSECTS);
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Turns a capture file written by common/capture.h into PPM images, one per recorded frame.
+//
+// Runs on the host, build with:
+//
+//   gcc tools/capture2ppm.c -o build/capture2ppm
+//
+// capture2ppm <capture file> <output prefix> [first frame] [last frame]
+//
+// Writes <prefix>_<frame>.ppm, frame numbers as recorded so dropped frames show up as gaps.  Until the
+// capture has a palette, colours are a grey ramp.
+//
+
+#define REC_PALETTE 1
+#define REC_FRAME 2
+#define REC_END 0xff
+
+#define FORMAT_CHUNKY 0
+
+static unsigned long getVar(FILE* file) {
+    unsigned long v = 0;
+    int shift = 0;
+    int c;
+    while ((c = getc(file)) != EOF) {
+        v |= (unsigned long) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    return v;
+}
+
+static int get16(FILE* file) {
+    int hi = getc(file);
+    int lo = getc(file);
+    return ((hi & 0xff) << 8) | (lo & 0xff);
+}
+
+/* Unpack one ByteRun1 row, XORing it into 'row' */
+static int unpackRow(FILE* file, unsigned char* row, int rowBytes) {
+    int i = 0;
+    while (i < rowBytes) {
+        int n = getc(file);
+        if (n == EOF) {
+            return 0;
+        }
+        if (n < 128) {
+            for (int k = 0; k <= n && i < rowBytes; k++) {
+                row[i++] ^= (unsigned char) getc(file);
+            }
+        } else if (n > 128) {
+            unsigned char v = (unsigned char) getc(file);
+            for (int k = 0; k < 257 - n && i < rowBytes; k++) {
+                row[i++] ^= v;
+            }
+        }
+    }
+    return 1;
+}
+
+static int writePpm(const char* path, const unsigned char* frame, int width, int height, int format, int depth,
+                    int rowBytes, const unsigned char* palette) {
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        return 0;
+    }
+
+    fprintf(out, "P6\n%d %d\n255\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int index;
+            if (format == FORMAT_CHUNKY) {
+                index = frame[y * rowBytes + x];
+            } else {
+                index = 0;
+                for (int p = 0; p < depth; p++) {
+                    if (frame[(p * height + y) * rowBytes + (x >> 3)] & (0x80 >> (x & 7))) {
+                        index |= 1 << p;
+                    }
+                }
+            }
+            fwrite(palette + index * 3, 1, 3, out);
+        }
+    }
+
+    fclose(out);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("usage: %s <capture file> <output prefix> [first frame] [last frame]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned long firstFrame = argc > 3 ? strtoul(argv[3], NULL, 0) : 0;
+    unsigned long lastFrame = argc > 4 ? strtoul(argv[4], NULL, 0) : (unsigned long) -1;
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        printf("Can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "AOSC", 4) != 0 || getc(file) != 1) {
+        printf("Not a capture file: %s\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    int width = get16(file);
+    int height = get16(file);
+    int format = getc(file);
+    int depth = getc(file);
+    int rowBytes = format == FORMAT_CHUNKY ? width : (width + 7) >> 3;
+    int numRows = format == FORMAT_CHUNKY ? height : height * depth;
+
+    unsigned char* frame = calloc(numRows, rowBytes);
+    unsigned char palette[256 * 3];
+    int numColours = format == FORMAT_CHUNKY ? 256 : 1 << depth;
+    for (int i = 0; i < 256; i++) {
+        unsigned char grey = (unsigned char) (numColours > 1 ? (i * 255 / (numColours - 1)) & 0xff : 0);
+        palette[i * 3] = palette[i * 3 + 1] = palette[i * 3 + 2] = grey;
+    }
+
+    printf("%d x %d %s, %d bit\n", width, height, format == FORMAT_CHUNKY ? "chunky" : "planar", depth);
+
+    unsigned long frameNumber = 0;
+    unsigned long ms = 0;
+    unsigned long written = 0;
+    int type;
+
+    while ((type = getc(file)) != EOF && type != REC_END) {
+        if (type == REC_PALETTE) {
+            unsigned long first = getVar(file);
+            unsigned long count = getVar(file);
+            for (unsigned long i = first; i < first + count; i++) {
+                for (int c = 0; c < 3; c++) {
+                    int v = getc(file);
+                    if (i < 256) {
+                        palette[i * 3 + c] = (unsigned char) v;
+                    }
+                }
+            }
+        } else if (type == REC_FRAME) {
+            frameNumber += getVar(file);
+            ms += getVar(file);
+            int changed = get16(file);
+            int row = 0;
+
+            for (int i = 0; i < changed; i++) {
+                row += (int) getVar(file);
+                if (row >= numRows || !unpackRow(file, frame + row * rowBytes, rowBytes)) {
+                    printf("Corrupt frame %lu\n", frameNumber);
+                    fclose(file);
+                    return 1;
+                }
+                row++;
+            }
+
+            if (frameNumber >= firstFrame && frameNumber <= lastFrame) {
+                char path[1024];
+                snprintf(path, sizeof(path), "%s_%06lu.ppm", argv[2], frameNumber);
+                if (!writePpm(path, frame, width, height, format, depth, rowBytes, palette)) {
+                    printf("Can't write %s\n", path);
+                    fclose(file);
+                    return 1;
+                }
+                written++;
+            }
+        } else {
+            printf("Unknown record %d\n", type);
+            break;
+        }
+    }
+
+    printf("last frame %lu at %lu ms, %lu images written\n", frameNumber, ms, written);
+
+    free(frame);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//
+// Adds up a profile written by common/profiler.h per function, using the program's linker map or nm output.
+//
+// Runs on the host, build with:
+//
+//   gcc tools/profmap.c -o build/profmap
+//
+// profmap <profile> <map file> [functions]
+//
+// The map is either a GNU ld map (-Wl,-Map,<file>), which only lists global symbols, or the output of
+// 'nm -n <program>' (m68k-amigaos-nm for Amiga builds), which has the static functions too - most of
+// common/ is static, so nm is the one to use unless the program was built with everything global.
+// Prints the top 'functions' (default 30) by samples, with their share of all samples taken and of the
+// samples that landed in the program.
+//
+
+#define MAX_LINE 1024
+
+typedef struct sSymbol {
+    unsigned long address;
+    char* name;
+    unsigned long samples;
+} Symbol;
+
+static Symbol* symbols;
+static int numSymbols;
+static int maxSymbols;
+
+static void addSymbol(unsigned long address, const char* name) {
+    if (numSymbols == maxSymbols) {
+        maxSymbols = maxSymbols ? maxSymbols * 2 : 1024;
+        if (!(symbols = realloc(symbols, maxSymbols * sizeof(Symbol)))) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+    symbols[numSymbols].address = address;
+    symbols[numSymbols].name = strdup(name);
+    symbols[numSymbols].samples = 0;
+    numSymbols++;
+}
+
+static int isHex(const char* s) {
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s += 2;
+    }
+    if (!*s) {
+        return 0;
+    }
+    for (; *s; s++) {
+        if (!isxdigit((unsigned char) *s)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Code symbols from an ld map ('0x<address> <name>' lines in .text output sections) or nm ('<address> T <name>') */
+static int readMap(const char* path) {
+    FILE* file = fopen(path, "r");
+    char line[MAX_LINE];
+    int inText = 0;
+
+    if (!file) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        char a[MAX_LINE], b[MAX_LINE], c[MAX_LINE];
+        int n = sscanf(line, "%s %s %s", a, b, c);
+
+        /* ld map: output sections start in the first column */
+        if (line[0] == '.') {
+            inText = strncmp(a, ".text", 5) == 0;
+            continue;
+        }
+
+        if (n == 3 && isHex(a) && strlen(b) == 1 && strchr("tTwW", b[0])) {
+            addSymbol(strtoul(a, NULL, 16), c);
+        } else if (n == 2 && inText && isspace((unsigned char) line[0]) && isHex(a) && a[1] == 'x' &&
+                   !isHex(b) && (isalpha((unsigned char) b[0]) || b[0] == '_')) {
+            addSymbol(strtoul(a, NULL, 16), b);
+        }
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static int byAddress(const void* a, const void* b) {
+    const Symbol* x = a;
+    const Symbol* y = b;
+    return x->address < y->address ? -1 : x->address > y->address;
+}
+
+static int bySamples(const void* a, const void* b) {
+    const Symbol* x = a;
+    const Symbol* y = b;
+    return x->samples > y->samples ? -1 : x->samples < y->samples;
+}
+
+/* Last symbol at or below 'address', -1 if there's none */
+static int findSymbol(unsigned long address) {
+    int lo = 0;
+    int hi = numSymbols - 1;
+    int found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (symbols[mid].address <= address) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+static const Symbol* findName(const char* name) {
+    for (int i = 0; i < numSymbols; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            return &symbols[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    char line[MAX_LINE];
+    int version = 0;
+    unsigned long interval = 0, anchor = 0;
+    unsigned long ticks = 0, program = 0, waiting = 0, outside = 0, unknown = 0, dropped = 0;
+    unsigned long unmapped = 0;
+
+    if (argc < 3) {
+        printf("usage: %s <profile> <map file> [functions]\n", argv[0]);
+        return 0;
+    }
+    int maxLines = argc > 3 ? atoi(argv[3]) : 30;
+
+    FILE* file = fopen(argv[1], "r");
+    if (!file) {
+        printf("Can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (!fgets(line, sizeof(line), file) || sscanf(line, "AOSP %d", &version) != 1 || version != 1 ||
+        !fgets(line, sizeof(line), file) || sscanf(line, "interval %lu", &interval) != 1 ||
+        !fgets(line, sizeof(line), file) || sscanf(line, "anchor %lx", &anchor) != 1 ||
+        !fgets(line, sizeof(line), file) ||
+        sscanf(line, "ticks %lu program %lu waiting %lu outside %lu unknown %lu dropped %lu",
+               &ticks, &program, &waiting, &outside, &unknown, &dropped) != 6) {
+        printf("%s is not a profile\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    if (!readMap(argv[2]) || !numSymbols) {
+        printf("No code symbols in %s\n", argv[2]);
+        fclose(file);
+        return 1;
+    }
+    qsort(symbols, numSymbols, sizeof(Symbol), byAddress);
+
+    const Symbol* anchorSymbol = findName("main");
+    if (!anchorSymbol) {
+        anchorSymbol = findName("_main");
+    }
+    if (!anchorSymbol) {
+        printf("No main in %s to line the profile up with\n", argv[2]);
+        fclose(file);
+        return 1;
+    }
+    unsigned long base = anchorSymbol->address - anchor;
+
+    unsigned long offset, samples;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "%lx %lu", &offset, &samples) != 2) {
+            continue;
+        }
+        int i = findSymbol(base + offset);
+        if (i < 0) {
+            unmapped += samples;
+        } else {
+            symbols[i].samples += samples;
+        }
+    }
+    fclose(file);
+
+    printf("%lu samples every %lu us: %lu in the program, %lu waiting, %lu outside, %lu unknown, %lu dropped\n",
+           ticks, interval, program, waiting, outside, unknown, dropped);
+    if (unmapped) {
+        printf("%lu samples before the first symbol\n", unmapped);
+    }
+    if (!ticks) {
+        return 0;
+    }
+
+    qsort(symbols, numSymbols, sizeof(Symbol), bySamples);
+    printf("  all%%  prog%%  samples  function\n");
+    for (int i = 0; i < numSymbols && i < maxLines && symbols[i].samples; i++) {
+        printf("%6.1f %6.1f %8lu  %s\n", symbols[i].samples * 100.0 / ticks,
+               program ? symbols[i].samples * 100.0 / program : 0.0, symbols[i].samples, symbols[i].name);
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "../common/platform.h"
+#include "../common/shmframes.h"
+
+//
+// Live viewer for frames exported through common/shmframes.h (host/insects.c).  Maps the shared memory read
+// only and draws the latest complete frame into the terminal with 24 bit colour half blocks, two pixel rows
+// per character row.  Never touches anything the producer looks at, so it can't slow it down.
+//
+// Build with:
+//
+//   gcc -O2 tools/shmview.c -lrt -o build/shmview
+//
+// shmview [-shm <name>] [-cols <n>] [-fps <n>] [-ppm <file>]
+//
+// '-ppm <file>' saves the latest frame as an image and exits.
+//
+
+static volatile sig_atomic_t viewQuit = 0;
+
+static void View_onSignal(int sig) {
+    viewQuit = 1;
+}
+
+static void View_sleepMs(long ms) {
+    struct timespec t = {ms / 1000, (ms % 1000) * 1000000};
+    nanosleep(&t, NULL);
+}
+
+static int View_savePpm(const ShmFrames* shm, const char* path) {
+    const ShmFramesHeader* header = shm->header;
+    uint32_t slot, seq;
+    const unsigned char* frame;
+    unsigned char* rgb = malloc((size_t) header->width * 3);
+    int saved = FALSE;
+
+    if (!rgb) {
+        return FALSE;
+    }
+
+    for (int tries = 0; tries < 100; tries++) {
+        if (!(frame = ShmFrames_latest(shm, &slot, &seq))) {
+            View_sleepMs(1);
+            continue;
+        }
+
+        FILE* out = fopen(path, "wb");
+        if (!out) {
+            break;
+        }
+        fprintf(out, "P6\n%u %u\n255\n", header->width, header->height);
+        for (uint32_t y = 0; y < header->height; y++) {
+            const unsigned char* row = frame + y * header->bytesPerRow;
+            for (uint32_t x = 0; x < header->width; x++) {
+                uint32_t colour = header->palette[row[x]];
+                rgb[x * 3] = (unsigned char) (colour >> 16);
+                rgb[x * 3 + 1] = (unsigned char) (colour >> 8);
+                rgb[x * 3 + 2] = (unsigned char) colour;
+            }
+            fwrite(rgb, 3, header->width, out);
+        }
+        fclose(out);
+
+        if (ShmFrames_stillValid(shm, slot, seq)) {
+            printf("saved frame %u to %s\n", header->slots[slot].frame, path);
+            saved = TRUE;
+            break;
+        }
+    }
+    free(rgb);
+    return saved;
+}
+
+int main(int argc, char** argv) {
+    const char* shmName = "/aos-frames";
+    const char* ppmPath = NULL;
+    int cols = 80;
+    int fps = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc) {
+            shmName = argv[++i];
+        } else if (strcmp(argv[i], "-cols") == 0 && i + 1 < argc) {
+            cols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+            fps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-ppm") == 0 && i + 1 < argc) {
+            ppmPath = argv[++i];
+        }
+    }
+
+    if (cols < 8) {
+        cols = 8;
+    }
+    if (fps < 1) {
+        fps = 1;
+    }
+
+    ShmFrames shm;
+    if (!ShmFrames_attach(&shm, shmName)) {
+        printf("No frames in shared memory %s (is the producer running?)\n", shmName);
+        return 1;
+    }
+
+    const ShmFramesHeader* header = shm.header;
+
+    if (ppmPath) {
+        int ok = View_savePpm(&shm, ppmPath);
+        ShmFrames_close(&shm);
+        return ok ? 0 : 1;
+    }
+
+    signal(SIGINT, View_onSignal);
+    signal(SIGTERM, View_onSignal);
+
+    int rows = (int) ((long) header->height * cols / header->width / 2);
+    size_t textSize = (size_t) rows * (cols * 48 + 16) + 256;
+    char* text = malloc(textSize);
+    uint32_t lastFrame = 0;
+    uint32_t lastProducerFrame = header->frame;
+    unsigned long shown = 0;
+    unsigned long torn = 0;
+    time_t lastSecond = time(NULL);
+    unsigned long producerFps = 0;
+
+    printf("\x1b[2J\x1b[?25l");
+
+    while (!viewQuit) {
+        uint32_t slot, seq;
+        const unsigned char* frame = ShmFrames_latest(&shm, &slot, &seq);
+        uint32_t frameNumber = frame ? header->slots[slot].frame : lastFrame;
+
+        if (frame && frameNumber != lastFrame) {
+            char* out = text;
+            out += sprintf(out, "\x1b[H");
+            for (int r = 0; r < rows; r++) {
+                const unsigned char* top = frame +
+                        (uint32_t) (r * 2 * header->height / (rows * 2)) * header->bytesPerRow;
+                const unsigned char* bottom = frame +
+                        (uint32_t) ((r * 2 + 1) * header->height / (rows * 2)) * header->bytesPerRow;
+                for (int c = 0; c < cols; c++) {
+                    uint32_t x = (uint32_t) c * header->width / cols;
+                    uint32_t fg = header->palette[top[x]];
+                    uint32_t bg = header->palette[bottom[x]];
+                    out += sprintf(out, "\x1b[38;2;%u;%u;%um\x1b[48;2;%u;%u;%um\xe2\x96\x80",
+                                   fg >> 16, (fg >> 8) & 0xff, fg & 0xff, bg >> 16, (bg >> 8) & 0xff, bg & 0xff);
+                }
+                out += sprintf(out, "\x1b[0m\n");
+            }
+
+            /* only show it if the producer didn't come round and start redrawing it meanwhile */
+            if (ShmFrames_stillValid(&shm, slot, seq)) {
+                fwrite(text, 1, out - text, stdout);
+                printf("frame %u  producer %lu fps  shown %lu  torn %lu   \n", frameNumber, producerFps, shown, torn);
+                fflush(stdout);
+                lastFrame = frameNumber;
+                shown++;
+            } else {
+                torn++;
+            }
+        }
+
+        time_t now = time(NULL);
+        if (now != lastSecond) {
+            uint32_t producerFrame = header->frame;
+            producerFps = (producerFrame - lastProducerFrame) / (unsigned long) (now - lastSecond);
+            lastProducerFrame = producerFrame;
+            lastSecond = now;
+        }
+
+        View_sleepMs(1000 / fps);
+    }
+
+    printf("\x1b[0m\x1b[?25h\n");
+    free(text);
+    ShmFrames_close(&shm);
+    return 0;
+}
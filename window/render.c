@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <intuition/intuition.h>
+#include <intuition/screens.h>
+#include <graphics/gfxbase.h>
+#include <clib/intuition_protos.h>
+#include <clib/graphics_protos.h>
+#include <clib/exec_protos.h>
+
+#include "../common/input.h"
+#include "../common/replay.h"
+#include "../common/memory.h"
+#include "../common/flock.h"
+#include "../common/counters.h"
+
+#define KC_ESC 0x45
+#define KC_SPACE 0x40
+#define VIEW_WIDTH 320
+#define VIEW_HEIGHT 256
+#define DEFAULT_INSECTS 200
+#define NEIGHBOUR_RADIUS 16
+
+//
+// Flocking insects in a window on the Workbench screen.
+//
+// Frames are drawn into an off-screen bitmap allocated as a friend of the screen's bitmap, so the blit to the
+// window is a straight copy in the screen's own format (planar or RTG), then copied with BltBitMapRastPort().
+// That goes through the window's layer, which clips it to whatever parts of the window are visible, so
+// overlapping windows cost nothing extra and nothing is ever drawn twice.
+//
+// The window is SimpleRefresh: there is no backing store for covered parts, Intuition sends
+// IDCMP_REFRESHWINDOW when something is uncovered and only the damaged area is copied again from the
+// off-screen bitmap between BeginRefresh() and EndRefresh().  Space pauses the animation, after which only
+// damage is redrawn - move other windows over it to see that.
+//
+// The window asks for a 320 x 256 view but lets Intuition shrink it to fit the screen (a 256 line PAL
+// Workbench has no room for that plus the borders), all the blits are then clipped to what it got.
+//
+// '-insects <n>' sets how many, render / blit times per frame are printed on exit.
+//
+
+static struct IntuitionBase* IntuitionBase;
+static struct GfxBase* GfxBase;
+struct Device* TimerBase;
+
+static struct Screen* aosScreen;
+static struct Window* aosWindow;
+static struct BitMap* aosBitMap;
+static struct RastPort aosRastPort;
+
+/* How much of the view fits inside the window's borders */
+static int viewWidth;
+static int viewHeight;
+
+/* Pens shared with the rest of the screen, released before the window closes */
+static LONG backgroundPen = -1;
+static LONG insectPen = -1;
+
+/* Input gathered once per frame, mouse moves merged - see common/input.h */
+static InputState aosInput;
+static InputSnapshot aosInputSnapshot;
+
+/* '-record <file>' / '-replay <file>' on the command line, see common/replay.h */
+static Replay aosReplay;
+
+static Flock flock;
+
+static int paused = FALSE;
+static unsigned long frames = 0;
+static unsigned long refreshes = 0;
+static unsigned long refreshedPixels = 0;
+static clock_t renderClocks = 0;
+static clock_t blitClocks = 0;
+
+void AOS_cleanupAndExit(int exitCode) {
+    Replay_close(&aosReplay);
+
+    if (frames) {
+        printf("%d insects, %lu frames: render %lu us/frame, blit %lu us/frame\n",
+               flock.count, frames, (unsigned long) (renderClocks * (1000000 / CLOCKS_PER_SEC) / frames),
+               (unsigned long) (blitClocks * (1000000 / CLOCKS_PER_SEC) / frames));
+    }
+    printf("%lu damage refreshes, %lu pixels redrawn\n", refreshes, refreshedPixels);
+
+    if (aosScreen) {
+        if (insectPen >= 0) {
+            ReleasePen(aosScreen->ViewPort.ColorMap, insectPen);
+        }
+        if (backgroundPen >= 0) {
+            ReleasePen(aosScreen->ViewPort.ColorMap, backgroundPen);
+        }
+    }
+
+    if (aosWindow) {
+        CloseWindow(aosWindow);
+        aosWindow = 0;
+    }
+
+    if (aosBitMap) {
+        WaitBlit();
+        FreeBitMap(aosBitMap);
+        aosBitMap = 0;
+    }
+
+    Flock_free(&flock);
+    Counters_print();
+    Mem_printUsage();
+
+    if (IntuitionBase) {
+        CloseLibrary((struct Library*) IntuitionBase);
+    }
+
+    if (GfxBase) {
+        CloseLibrary((struct Library*) GfxBase);
+    }
+
+    exit(exitCode);
+}
+
+void AOS_init(int numInsects) {
+    if (!(IntuitionBase = (struct IntuitionBase*) OpenLibrary((UBYTE*) "intuition.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!(GfxBase = (struct GfxBase*) OpenLibrary((UBYTE*) "graphics.library", 39))) {
+        AOS_cleanupAndExit(0);
+    }
+
+    if (!Flock_init(&flock, numInsects, VIEW_WIDTH, VIEW_HEIGHT, NEIGHBOUR_RADIUS)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    struct Screen* publicScreen = LockPubScreen(NULL);
+    if (!publicScreen) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosWindow = OpenWindowTags(NULL,
+                               WA_Left, 40,
+                               WA_Top, 30,
+                               WA_InnerWidth, VIEW_WIDTH,
+                               WA_InnerHeight, VIEW_HEIGHT,
+                               WA_PubScreen, publicScreen,
+                               WA_Title, (ULONG) "Insects",
+                               WA_DragBar, TRUE,
+                               WA_DepthGadget, TRUE,
+                               WA_CloseGadget, TRUE,
+                               WA_Activate, TRUE,
+                               WA_SimpleRefresh, TRUE,
+                               WA_RMBTrap, TRUE,
+                               WA_AutoAdjust, TRUE,
+                               WA_IDCMP, IDCMP_CLOSEWINDOW | IDCMP_REFRESHWINDOW | IDCMP_RAWKEY,
+                               TAG_DONE);
+
+    /* The window keeps the screen open from here on */
+    UnlockPubScreen(NULL, publicScreen);
+
+    if (!aosWindow) {
+        AOS_cleanupAndExit(0);
+    }
+
+    aosScreen = aosWindow->WScreen;
+
+    viewWidth = aosWindow->Width - aosWindow->BorderLeft - aosWindow->BorderRight;
+    viewHeight = aosWindow->Height - aosWindow->BorderTop - aosWindow->BorderBottom;
+    if (viewWidth > VIEW_WIDTH) {
+        viewWidth = VIEW_WIDTH;
+    }
+    if (viewHeight > VIEW_HEIGHT) {
+        viewHeight = VIEW_HEIGHT;
+    }
+
+    /* Same depth and layout as the screen, so BltBitMapRastPort() is a plain copy */
+    struct BitMap* screenBitMap = aosScreen->RastPort.BitMap;
+    aosBitMap = AllocBitMap(VIEW_WIDTH, VIEW_HEIGHT, GetBitMapAttr(screenBitMap, BMA_DEPTH), BMF_CLEAR,
+                            screenBitMap);
+    if (!aosBitMap) {
+        AOS_cleanupAndExit(0);
+    }
+
+    InitRastPort(&aosRastPort);
+    aosRastPort.BitMap = aosBitMap;
+
+    struct ColorMap* colorMap = aosScreen->ViewPort.ColorMap;
+    backgroundPen = ObtainBestPen(colorMap, 0x00000000, 0x00000000, 0x00000000,
+                                  OBP_Precision, PRECISION_IMAGE, TAG_DONE);
+    insectPen = ObtainBestPen(colorMap, 0xffffffff, 0xffffffff, 0x00000000,
+                              OBP_Precision, PRECISION_IMAGE, TAG_DONE);
+    if (backgroundPen < 0 || insectPen < 0) {
+        AOS_cleanupAndExit(0);
+    }
+
+    Input_attach(&aosInput, aosWindow);
+}
+
+void initInsects(int numInsects) {
+    for (int i = 0; i < numInsects; i++) {
+        double angle = (rand() % 256) * M_PI * 2 / 256;
+        Flock_add(&flock, (long) (rand() % VIEW_WIDTH) << 16, (long) (rand() % VIEW_HEIGHT) << 16,
+                  (long) (2 * 65536 * cos(angle)), (long) (2 * 65536 * sin(angle)));
+    }
+}
+
+/* Draw the next frame into the off-screen bitmap */
+void renderInsects() {
+    SetRast(&aosRastPort, backgroundPen);
+    Counters_SetAPen(&aosRastPort, insectPen);
+    for (int i = 0; i < flock.count; i++) {
+        Counters_WritePixel(&aosRastPort, flock.x[i] >> 16, flock.y[i] >> 16);
+    }
+}
+
+/*
+ * Copy part of the off-screen bitmap to the same place in the window, the layer clips it to what's visible.
+ * The layer includes the borders, so callers keep to viewWidth x viewHeight.
+ */
+void blitView(int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    BltBitMapRastPort(aosBitMap, x, y, aosWindow->RPort, aosWindow->BorderLeft + x, aosWindow->BorderTop + y,
+                      width, height, 0xc0);
+}
+
+/*
+ * IDCMP_REFRESHWINDOW: something uncovered part of the window.  Between BeginRefresh() and EndRefresh() the
+ * layer only lets drawing through to the damaged area, so copying the damage bounds from the off-screen
+ * bitmap repairs it without touching anything still on screen.
+ */
+void refreshDamage() {
+    BeginRefresh(aosWindow);
+
+    /* Bounds of the damage in window coordinates, limited to the view inside the borders */
+    struct Rectangle* bounds = &aosWindow->WLayer->DamageList->bounds;
+    int x0 = bounds->MinX - aosWindow->BorderLeft;
+    int y0 = bounds->MinY - aosWindow->BorderTop;
+    int x1 = bounds->MaxX - aosWindow->BorderLeft;
+    int y1 = bounds->MaxY - aosWindow->BorderTop;
+    if (x0 < 0) {
+        x0 = 0;
+    }
+    if (y0 < 0) {
+        y0 = 0;
+    }
+    if (x1 >= viewWidth) {
+        x1 = viewWidth - 1;
+    }
+    if (y1 >= viewHeight) {
+        y1 = viewHeight - 1;
+    }
+
+    if (x0 <= x1 && y0 <= y1) {
+        blitView(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+        refreshedPixels += (unsigned long) (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+
+    EndRefresh(aosWindow, TRUE);
+    refreshes++;
+}
+
+/* Process any pending events */
+static int AOS_processEvents() {
+    int close = FALSE;
+
+    Input_pump(&aosInput, aosWindow);
+    Input_snapshot(&aosInput, &aosInputSnapshot);
+    Replay_process(&aosReplay, &aosInputSnapshot);
+
+    /* Escape and close gadget exit, space pauses */
+    for (int i = 0; i < aosInputSnapshot.numEvents; i++) {
+        InputMsg* msg = &aosInputSnapshot.events[i];
+        switch (msg->cls) {
+            case IDCMP_CLOSEWINDOW:
+                close = TRUE;
+                break;
+            case IDCMP_REFRESHWINDOW:
+                /* The damage stays in the layer until EndRefresh(), so the message being replied already is fine */
+                refreshDamage();
+                break;
+            case IDCMP_RAWKEY: {
+                WORD code = msg->code;
+                if (code == KC_ESC) {
+                    close = TRUE;
+                } else if (code == KC_SPACE) {
+                    paused = !paused;
+                }
+                break;
+            }
+        }
+    }
+
+    return !close && !aosReplay.finished;
+}
+
+int main(int argc, char** argv) {
+    int numInsects = DEFAULT_INSECTS;
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-insects") == 0) {
+            numInsects = atoi(argv[++i]);
+        }
+    }
+
+    if (numInsects < 1) {
+        numInsects = 1;
+    }
+
+    AOS_init(numInsects);
+
+    if (!Replay_openFromArgs(&aosReplay, argc, argv)) {
+        AOS_cleanupAndExit(0);
+    }
+
+    srand(4);
+
+    initInsects(numInsects);
+
+    while (AOS_processEvents()) {
+        if (paused) {
+            /* Nothing changes, so only damage gets redrawn */
+            WaitPort(aosWindow->UserPort);
+            continue;
+        }
+
+        clock_t start = clock();
+        Flock_update(&flock);
+        renderInsects();
+        clock_t rendered = clock();
+        renderClocks += rendered - start;
+
+        WaitTOF();
+        rendered = clock();
+        blitView(0, 0, viewWidth, viewHeight);
+        WaitBlit();
+        blitClocks += clock() - rendered;
+
+        frames++;
+        Counters_endFrame();
+    }
+
+    AOS_cleanupAndExit(0);
+
+    return 0;
+}